@@ -24,7 +24,7 @@
 #include <Rcpp.h>
 #include <RcppArmadillo.h>
 
-enum armaT { doubleT, vecT, matT, intT, ivecT, imatT };
+enum armaT { doubleT, vecT, matT, intT, ivecT, imatT, spmatT };
 
 class ArmaContext {
   armaT armatype_;
@@ -42,6 +42,12 @@ public:
   virtual arma::ivec& getiVec() { throw std::logic_error("ERROR: Arma type conversion not supported."); }
   virtual arma::imat& getiMat() { throw std::logic_error("ERROR: Arma type conversion not supported."); }
 
+  // single precision copies of real types
+  virtual arma::fmat& getfMat() { throw std::logic_error("ERROR: Arma type conversion not supported."); }
+
+  // sparse types
+  virtual arma::sp_mat& getSpMat() { throw std::logic_error("ERROR: Arma type conversion not supported."); }
+
   //virtual void print() const = 0;
 };
 
@@ -66,9 +72,16 @@ public:
 class ArmaMat : public ArmaContext {
 private:
   arma::mat x_;
+  // float copy for the design matrices of precision = "single" nodes, made
+  // on first use and shared by every node using this matrix
+  arma::fmat xf_;
 public:
   ArmaMat(SEXP x_sexp): ArmaContext(matT), x_(arma::mat(REAL(x_sexp), Rf_nrows(x_sexp), Rf_ncols(x_sexp), false)) {}
   arma::mat& getMat() { return x_; }
+  arma::fmat& getfMat() {
+    if(xf_.n_elem != x_.n_elem) { xf_ = arma::conv_to<arma::fmat>::from(x_); }
+    return xf_;
+  }
   //void print() const { std::cout << x_ << std::endl; }
 };
 
@@ -100,5 +113,27 @@ public:
   //void print() const { std::cout << x_ << std::endl; }
 };
 
+// Matrix::dgCMatrix, never densified: the compressed columns are copied once
+// into arma's own storage (its index type is not R's int, so the slots
+// cannot be used in place)
+class ArmaSpMat : public ArmaContext {
+private:
+  arma::sp_mat x_;
+
+  static arma::sp_mat fromDgC(SEXP x_sexp) {
+    SEXP i_ = R_do_slot(x_sexp, Rf_install("i"));
+    SEXP p_ = R_do_slot(x_sexp, Rf_install("p"));
+    SEXP values_ = R_do_slot(x_sexp, Rf_install("x"));
+    const int* dim = INTEGER(R_do_slot(x_sexp, Rf_install("Dim")));
+    arma::uvec row_indices(Rf_length(i_)), col_ptrs(Rf_length(p_));
+    for(arma::uword k = 0; k < row_indices.n_elem; k++) { row_indices[k] = INTEGER(i_)[k]; }
+    for(arma::uword k = 0; k < col_ptrs.n_elem; k++) { col_ptrs[k] = INTEGER(p_)[k]; }
+    const arma::vec values(REAL(values_), Rf_length(values_), false);
+    return arma::sp_mat(row_indices, col_ptrs, values, dim[0], dim[1]);
+  }
+public:
+  ArmaSpMat(SEXP x_sexp): ArmaContext(spmatT), x_(fromDgC(x_sexp)) {}
+  arma::sp_mat& getSpMat() { return x_; }
+};
 
 #endif // ARMA_CONTEXT_H
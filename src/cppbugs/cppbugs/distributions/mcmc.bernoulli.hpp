@@ -21,7 +21,9 @@
 
 #include <cmath>
 #include <armadillo>
-#include <cppbugs/mcmc.stochastic.hpp>
+#include <algorithm>
+#include <cppbugs/mcmc.dynamic.stochastic.hpp>
+#include <cppbugs/mcmc.observed.hpp>
 
 namespace cppbugs {
 
@@ -34,6 +36,11 @@ namespace cppbugs {
     inline double calc() const {
       return bernoulli_logp(x_,p_);
     }
+    size_t terms() const { return static_cast<size_t>(dim_size(x_)); }
+    double calc_terms(const size_t begin, const size_t end) const {
+      return bernoulli_logp<default_math>(x_,p_,begin,end);
+    }
+    void inputs(std::vector<const void*>& out) const { out.push_back(&x_); out.push_back(&p_); }
   };
 
   template<typename T>
@@ -42,9 +49,15 @@ namespace cppbugs {
     template<typename U>
     void bernoulli_jump(RngBase& rng, U& value, const double scale) {
       double jump_probability = 1.0 - pow(0.5,scale);
-      arma::uvec flips = arma::find(arma::randu<arma::vec>(value.n_elem) < jump_probability);
-      for(unsigned int i = 0; i < flips.n_elem; i++) {
-        value[ flips[i] ] = value[ flips[i] ] ? 0 : 1;
+      double u[jump_block_size];
+      for(size_t i = 0; i < value.n_elem; i += jump_block_size) {
+        const size_t n = std::min<size_t>(jump_block_size, value.n_elem - i);
+        rng.fill_uniform(u, n);
+        for(size_t j = 0; j < n; j++) {
+          if(u[j] < jump_probability) {
+            value[i + j] = value[i + j] ? 0 : 1;
+          }
+        }
       }
     }
 
@@ -69,9 +82,12 @@ namespace cppbugs {
       bernoulli_jump(rng, DynamicStochastic<T>::value, DynamicStochastic<T>::scale_);
     }
 
+    // flips can't be expressed as a flat random walk
+    bool jumpBounds(double& lower, double& upper) const { return false; }
+
     template<typename U>
     Bernoulli<T>& dbern(const U& p) {
-      Stochastic::likelihood_functor = new BernoulliLikelihiood<T,U>(DynamicStochastic<T>::value,p);
+      Stochastic::makeLikelihood<BernoulliLikelihiood<T,U> >(DynamicStochastic<T>::value,p);
       return *this;
     }
   };
@@ -83,7 +99,7 @@ namespace cppbugs {
 
     template<typename U>
     ObservedBernoulli<T>& dbern(const U& p) {
-      Stochastic::likelihood_functor = new BernoulliLikelihiood<T,U>(Observed<T>::value,p);
+      Stochastic::makeLikelihood<BernoulliLikelihiood<T,U> >(Observed<T>::value,p);
       return *this;
     }
   };
@@ -18,6 +18,7 @@
 #ifndef MCMC_BETA_HPP
 #define MCMC_BETA_HPP
 
+#include <vector>
 #include <armadillo>
 #include <cppbugs/mcmc.dynamic.stochastic.hpp>
 #include <cppbugs/mcmc.observed.hpp>
@@ -29,11 +30,56 @@ namespace cppbugs {
     const T& x_;
     const U& alpha_;
     const V& beta_;
+    mutable HyperTermCache cache_;
+    bool hyper_;
   public:
-    BetaLikelihiood(  const T& x,  const U& alpha,  const V& beta): x_(x), alpha_(alpha), beta_(beta) { dimension_check(x_, alpha_, beta_); }
+    BetaLikelihiood(  const T& x,  const U& alpha,  const V& beta): x_(x), alpha_(alpha), beta_(beta), hyper_(true) { dimension_check(x_, alpha_, beta_); }
     inline double calc() const {
-      return beta_logp(x_,alpha_,beta_);
+      return beta_logp<default_math>(x_,alpha_,beta_,0,terms(),&cache_,hyper_);
     }
+    size_t terms() const { return static_cast<size_t>(dim_size(x_)); }
+    // the cache is only needed for elementwise hyperparameters
+    void prepare() { cache_.prepare(is_scalar(alpha_) && is_scalar(beta_) ? 0 : terms()); }
+    double calc_terms(const size_t begin, const size_t end) const {
+      return beta_logp<default_math>(x_,alpha_,beta_,begin,end,&cache_,hyper_);
+    }
+    void inputs(std::vector<const void*>& out) const { out.push_back(&x_); out.push_back(&alpha_); out.push_back(&beta_); }
+    void dropConstants(const std::vector<bool>& fixed) { hyper_ = fixed.empty() || !(fixed[1] && fixed[2]); }
+  };
+
+  // observed x is fixed, so log(x), log(1-x) and the support check are done once here
+  template <typename T,typename U, typename V>
+  class ObservedBetaLikelihiood : public Likelihiood {
+    const T& x_;
+    const U& alpha_;
+    const V& beta_;
+    std::vector<double> log_x_, log_1mx_;
+    bool in_support_;
+    mutable HyperTermCache cache_;
+    bool hyper_;
+  public:
+    ObservedBetaLikelihiood(const T& x,  const U& alpha,  const V& beta): x_(x), alpha_(alpha), beta_(beta), in_support_(true), hyper_(true) {
+      dimension_check(x_, alpha_, beta_);
+      std::vector<double> xd;
+      observed_values(x_, xd);
+      log_x_.resize(xd.size());
+      log_1mx_.resize(xd.size());
+      for(size_t i = 0; i < xd.size(); i++) {
+        if(xd[i] <= 0 || xd[i] >= 1) { in_support_ = false; }
+        log_x_[i] = default_math::log(xd[i]);
+        log_1mx_[i] = default_math::log1p(-xd[i]);
+      }
+    }
+    inline double calc() const { return calc_terms(0,terms()); }
+    size_t terms() const { return log_x_.size(); }
+    void prepare() { cache_.prepare(is_scalar(alpha_) && is_scalar(beta_) ? 0 : log_x_.size()); }
+    double calc_terms(const size_t begin, const size_t end) const {
+      if(!in_support_) { return -std::numeric_limits<double>::infinity(); }
+      if(log_x_.empty()) { return 0; }
+      return beta_logp_observed<default_math>(x_,&log_x_[0],&log_1mx_[0],alpha_,beta_,begin,end,&cache_,hyper_);
+    }
+    void inputs(std::vector<const void*>& out) const { out.push_back(&x_); out.push_back(&alpha_); out.push_back(&beta_); }
+    void dropConstants(const std::vector<bool>& fixed) { hyper_ = fixed.empty() || !(fixed[1] && fixed[2]); }
   };
 
   template<typename T>
@@ -43,10 +89,14 @@ namespace cppbugs {
 
     // modified jumper to only take jumps on (0,1) interval
     void jump(RngBase& rng) { bounded_jump_impl(rng, DynamicStochastic<T>::value,DynamicStochastic<T>::scale_, 0, 1); }
+    bool jumpBounds(double& lower, double& upper) const {
+      lower = 0; upper = 1;
+      return flattenable<T>::value;
+    }
 
     template<typename U, typename V>
     Beta<T>& dbeta(const U& alpha, const V& beta) {
-      Stochastic::likelihood_functor = new BetaLikelihiood<T,U,V>(DynamicStochastic<T>::value,alpha,beta);
+      Stochastic::makeLikelihood<BetaLikelihiood<T,U,V> >(DynamicStochastic<T>::value,alpha,beta);
       return *this;
     }
   };
@@ -58,7 +108,7 @@ namespace cppbugs {
 
     template<typename U, typename V>
     ObservedBeta<T>& dbeta(const U& alpha, const V& beta) {
-      Stochastic::likelihood_functor = new BetaLikelihiood<T,U,V>(Observed<T>::value,alpha,beta);
+      Stochastic::makeLikelihood<ObservedBetaLikelihiood<T,U,V> >(Observed<T>::value,alpha,beta);
       return *this;
     }
   };
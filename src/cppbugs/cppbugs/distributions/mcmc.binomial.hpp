@@ -18,6 +18,7 @@
 #ifndef MCMC_BINOMIAL_HPP
 #define MCMC_BINOMIAL_HPP
 
+#include <vector>
 #include <armadillo>
 #include <cppbugs/mcmc.dynamic.stochastic.hpp>
 #include <cppbugs/mcmc.observed.hpp>
@@ -29,11 +30,66 @@ namespace cppbugs {
     const T& x_;
     const U& n_;
     const V& p_;
+    bool hyper_;
   public:
-    BinomialLikelihiood(const T& x,  const U& n,  const V& p): x_(x), n_(n), p_(p) { dimension_check(x_, n_, p_); }
+    BinomialLikelihiood(const T& x,  const U& n,  const V& p): x_(x), n_(n), p_(p), hyper_(true) { dimension_check(x_, n_, p_); }
     inline double calc() const {
-      return binom_logp(x_,n_,p_);
+      return binom_logp<default_math>(x_,n_,p_,0,terms(),hyper_);
     }
+    size_t terms() const { return static_cast<size_t>(dim_size(x_)); }
+    double calc_terms(const size_t begin, const size_t end) const {
+      return binom_logp<default_math>(x_,n_,p_,begin,end,hyper_);
+    }
+    void inputs(std::vector<const void*>& out) const { out.push_back(&x_); out.push_back(&n_); out.push_back(&p_); }
+    void dropConstants(const std::vector<bool>& fixed) { hyper_ = fixed.empty() || !(fixed[0] && fixed[1]); }
+  };
+
+  // observed x is fixed: its values and support check are taken once here
+  // a scalar n is almost always data, so the binomial coefficients for the n
+  // seen at construction are summed once (as running sums, so any block of
+  // terms costs one subtraction) and only a changed n recomputes them;
+  // an elementwise n caches the coefficient per element against n instead
+  template <typename T,typename U, typename V>
+  class ObservedBinomialLikelihiood : public Likelihiood {
+    const T& x_;
+    const U& n_;
+    const V& p_;
+    std::vector<double> xd_;
+    bool in_support_;
+    double coef_n_;
+    std::vector<double> coef_sums_;
+    mutable HyperTermCache coef_;
+    bool hyper_;
+  public:
+    ObservedBinomialLikelihiood(const T& x,  const U& n,  const V& p): x_(x), n_(n), p_(p), in_support_(true), coef_n_(0), hyper_(true) {
+      dimension_check(x_, n_, p_);
+      observed_values(x_, xd_);
+      for(size_t i = 0; i < xd_.size(); i++) {
+        if(xd_[i] < 0) { in_support_ = false; }
+      }
+      if(is_scalar(n_)) {
+        coef_n_ = elem(n_,0);
+        coef_sums_.assign(xd_.size() + 1, 0);
+        for(size_t i = 0; i < xd_.size(); i++) {
+          // x > n is outside the support, which calc_terms reports anyway
+          coef_sums_[i + 1] = coef_sums_[i] + (xd_[i] <= coef_n_ ? binom_coef_term::calc(coef_n_, xd_[i]) : 0);
+        }
+      }
+    }
+    inline double calc() const { return calc_terms(0,terms()); }
+    size_t terms() const { return xd_.size(); }
+    void prepare() { coef_.prepare(is_scalar(n_) ? 0 : xd_.size()); }
+    double calc_terms(const size_t begin, const size_t end) const {
+      if(!in_support_) { return -std::numeric_limits<double>::infinity(); }
+      if(xd_.empty()) { return 0; }
+      if(!coef_sums_.empty() && elem(n_,0) == coef_n_) {
+        const double ans = binom_logp_observed<default_math>(x_,&xd_[0],n_,p_,begin,end,NULL,false);
+        return hyper_ ? ans + (coef_sums_[end] - coef_sums_[begin]) : ans;
+      }
+      return binom_logp_observed<default_math>(x_,&xd_[0],n_,p_,begin,end,&coef_,hyper_);
+    }
+    void inputs(std::vector<const void*>& out) const { out.push_back(&x_); out.push_back(&n_); out.push_back(&p_); }
+    void dropConstants(const std::vector<bool>& fixed) { hyper_ = fixed.empty() || !(fixed[0] && fixed[1]); }
   };
 
   template<typename T>
@@ -43,7 +99,7 @@ namespace cppbugs {
 
     template<typename U, typename V>
     Binomial<T>& dbinom(const U& n, const V& p) {
-      Stochastic::likelihood_functor = new BinomialLikelihiood<T,U,V>(DynamicStochastic<T>::value,n,p);
+      Stochastic::makeLikelihood<BinomialLikelihiood<T,U,V> >(DynamicStochastic<T>::value,n,p);
       return *this;
     }
   };
@@ -55,7 +111,7 @@ namespace cppbugs {
 
     template<typename U, typename V>
     ObservedBinomial<T>& dbinom(const U& n, const V& p) {
-      Stochastic::likelihood_functor = new BinomialLikelihiood<T,U,V>(Observed<T>::value, n, p);
+      Stochastic::makeLikelihood<ObservedBinomialLikelihiood<T,U,V> >(Observed<T>::value, n, p);
       return *this;
     }
   };
@@ -35,6 +35,7 @@ namespace cppbugs {
 	return -std::numeric_limits<double>::infinity();
       return log_approx(p_[x_]);
     }
+    void inputs(std::vector<const void*>& out) const { out.push_back(&x_); out.push_back(&p_); }
   };
 
   template<typename T> class Discrete;
@@ -45,7 +46,7 @@ namespace cppbugs {
     Discrete(int& value): DynamicStochastic<int>(value) {}
 
     Discrete<int>& ddiscr(const arma::vec& p) {
-      Stochastic::likelihood_functor = new DiscreteLikelihiood(DynamicStochastic<int>::value,p);
+      Stochastic::makeLikelihood<DiscreteLikelihiood>(DynamicStochastic<int>::value,p);
       return *this;
     }
   };
@@ -58,7 +59,7 @@ namespace cppbugs {
     ObservedDiscrete(const int& value): Observed<int>(value) {}
 
     ObservedDiscrete<int>& ddiscr(const arma::vec& p) {
-      Stochastic::likelihood_functor = new DiscreteLikelihiood(Observed<int>::value,p);
+      Stochastic::makeLikelihood<DiscreteLikelihiood>(Observed<int>::value,p);
       return *this;
     }
   };
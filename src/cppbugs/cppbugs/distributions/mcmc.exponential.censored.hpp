@@ -33,8 +33,13 @@ namespace cppbugs {
   public:
     ExponentialCensoredLikelihiood(const T& x, const U& lambda, const V& delta): x_(x), lambda_(lambda), delta_(delta) { dimension_check(x_, lambda_, delta_); }
     inline double calc() const {
-      return arma::accu(arma::schur(delta_, log_approx(lambda_)) - arma::schur(lambda_, x_));
+      return exponential_censored_logp(x_,lambda_,delta_);
     }
+    size_t terms() const { return static_cast<size_t>(dim_size(x_)); }
+    double calc_terms(const size_t begin, const size_t end) const {
+      return exponential_censored_logp<default_math>(x_,lambda_,delta_,begin,end);
+    }
+    void inputs(std::vector<const void*>& out) const { out.push_back(&x_); out.push_back(&lambda_); out.push_back(&delta_); }
   };
 
   template<typename T>
@@ -44,7 +49,7 @@ namespace cppbugs {
 
     template<typename U, typename V>
     ObservedExponentialCensored<T>& dexpcens(const U& lambda, const V& delta) {
-      Stochastic::likelihood_functor = new ExponentialCensoredLikelihiood<T,U,V>(Observed<T>::value,lambda,delta);
+      Stochastic::makeLikelihood<ExponentialCensoredLikelihiood<T,U,V> >(Observed<T>::value,lambda,delta);
       return *this;
     }
   };
@@ -32,8 +32,13 @@ namespace cppbugs {
   public:
     ExponentialLikelihiood(const T& x, const U& lambda): x_(x), lambda_(lambda) { dimension_check(x_, lambda_); }
     inline double calc() const {
-      return arma::accu(log_approx(lambda_) - arma::schur(lambda_, x_));
+      return exponential_logp(x_,lambda_);
     }
+    size_t terms() const { return static_cast<size_t>(dim_size(x_)); }
+    double calc_terms(const size_t begin, const size_t end) const {
+      return exponential_logp<default_math>(x_,lambda_,begin,end);
+    }
+    void inputs(std::vector<const void*>& out) const { out.push_back(&x_); out.push_back(&lambda_); }
   };
 
   template<typename T>
@@ -43,10 +48,14 @@ namespace cppbugs {
 
     // modified jumper to only take positive jumps
     void jump(RngBase& rng) { positive_jump_impl(rng, DynamicStochastic<T>::value,DynamicStochastic<T>::scale_); }
+    bool jumpBounds(double& lower, double& upper) const {
+      lower = 0; upper = std::numeric_limits<double>::infinity();
+      return flattenable<T>::value;
+    }
 
     template<typename U>
     Exponential<T>& dexp(const U& lambda) {
-      Stochastic::likelihood_functor = new ExponentialLikelihiood<T,U>(DynamicStochastic<T>::value,lambda);
+      Stochastic::makeLikelihood<ExponentialLikelihiood<T,U> >(DynamicStochastic<T>::value,lambda);
       return *this;
     }
   };
@@ -58,7 +67,7 @@ namespace cppbugs {
 
     template<typename U>
     ObservedExponential<T>& dexp(const U& lambda) {
-      Stochastic::likelihood_functor = new ExponentialLikelihiood<T,U>(Observed<T>::value,lambda);
+      Stochastic::makeLikelihood<ExponentialLikelihiood<T,U> >(Observed<T>::value,lambda);
       return *this;
     }
   };
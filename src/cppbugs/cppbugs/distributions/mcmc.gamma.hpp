@@ -20,6 +20,7 @@
 
 
 #include <cmath>
+#include <vector>
 #include <armadillo>
 #include <cppbugs/mcmc.stochastic.hpp>
 
@@ -30,11 +31,53 @@ namespace cppbugs {
     const T& x_;
     const U& alpha_;
     const V& beta_;
+    mutable HyperTermCache cache_;
+    bool hyper_;
   public:
-    GammaLikelihiood(const T& x,  const U& alpha,  const V& beta): x_(x), alpha_(alpha), beta_(beta) { dimension_check(x_, alpha_, beta_); }
+    GammaLikelihiood(const T& x,  const U& alpha,  const V& beta): x_(x), alpha_(alpha), beta_(beta), hyper_(true) { dimension_check(x_, alpha_, beta_); }
     inline double calc() const {
-      return gamma_logp(x_,alpha_,beta_);
+      return gamma_logp<default_math>(x_,alpha_,beta_,0,terms(),&cache_,hyper_);
     }
+    size_t terms() const { return static_cast<size_t>(dim_size(x_)); }
+    // the cache is only needed for elementwise hyperparameters
+    void prepare() { cache_.prepare(is_scalar(alpha_) && is_scalar(beta_) ? 0 : terms()); }
+    double calc_terms(const size_t begin, const size_t end) const {
+      return gamma_logp<default_math>(x_,alpha_,beta_,begin,end,&cache_,hyper_);
+    }
+    void inputs(std::vector<const void*>& out) const { out.push_back(&x_); out.push_back(&alpha_); out.push_back(&beta_); }
+    void dropConstants(const std::vector<bool>& fixed) { hyper_ = fixed.empty() || !(fixed[1] && fixed[2]); }
+  };
+
+  // observed x is fixed, so log(x) and the support check are done once here
+  template <typename T,typename U, typename V>
+  class ObservedGammaLikelihiood : public Likelihiood {
+    const T& x_;
+    const U& alpha_;
+    const V& beta_;
+    std::vector<double> xd_, log_x_;
+    bool in_support_;
+    mutable HyperTermCache cache_;
+    bool hyper_;
+  public:
+    ObservedGammaLikelihiood(const T& x,  const U& alpha,  const V& beta): x_(x), alpha_(alpha), beta_(beta), in_support_(true), hyper_(true) {
+      dimension_check(x_, alpha_, beta_);
+      observed_values(x_, xd_);
+      log_x_.resize(xd_.size());
+      for(size_t i = 0; i < xd_.size(); i++) {
+        if(xd_[i] < 0) { in_support_ = false; }
+        log_x_[i] = default_math::log(xd_[i]);
+      }
+    }
+    inline double calc() const { return calc_terms(0,terms()); }
+    size_t terms() const { return xd_.size(); }
+    void prepare() { cache_.prepare(is_scalar(alpha_) && is_scalar(beta_) ? 0 : xd_.size()); }
+    double calc_terms(const size_t begin, const size_t end) const {
+      if(!in_support_) { return -std::numeric_limits<double>::infinity(); }
+      if(xd_.empty()) { return 0; }
+      return gamma_logp_observed<default_math>(x_,&xd_[0],&log_x_[0],alpha_,beta_,begin,end,&cache_,hyper_);
+    }
+    void inputs(std::vector<const void*>& out) const { out.push_back(&x_); out.push_back(&alpha_); out.push_back(&beta_); }
+    void dropConstants(const std::vector<bool>& fixed) { hyper_ = fixed.empty() || !(fixed[1] && fixed[2]); }
   };
 
   template<typename T>
@@ -44,10 +87,14 @@ namespace cppbugs {
 
     // modified jumper to only take positive jumps
     void jump(RngBase& rng) { positive_jump_impl(rng, DynamicStochastic<T>::value,DynamicStochastic<T>::scale_); }
+    bool jumpBounds(double& lower, double& upper) const {
+      lower = 0; upper = std::numeric_limits<double>::infinity();
+      return flattenable<T>::value;
+    }
 
     template<typename U, typename V>
     Gamma<T>& dgamma(const U& alpha, const V& beta) {
-      Stochastic::likelihood_functor = new GammaLikelihiood<T,U,V>(DynamicStochastic<T>::value,alpha,beta);
+      Stochastic::makeLikelihood<GammaLikelihiood<T,U,V> >(DynamicStochastic<T>::value,alpha,beta);
       return *this;
     }
   };
@@ -59,7 +106,7 @@ namespace cppbugs {
 
     template<typename U, typename V>
     ObservedGamma<T>& dgamma(const U& alpha, const V& beta) {
-      Stochastic::likelihood_functor = new GammaLikelihiood<T,U,V>(Observed<T>::value,alpha,beta);
+      Stochastic::makeLikelihood<ObservedGammaLikelihiood<T,U,V> >(Observed<T>::value,alpha,beta);
       return *this;
     }
   };
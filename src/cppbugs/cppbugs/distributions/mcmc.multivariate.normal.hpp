@@ -29,8 +29,11 @@ namespace cppbugs {
     const T& x_;
     const U& mu_;
     const arma::mat& sigma_;
+    // scratch space for the cholesky factor and the whitened residual
+    mutable arma::mat R_;
+    mutable arma::vec z_;
   public:
-    MultivariateNormalLikelihiood(const T& x,  const U& mu,  const arma::mat& sigma): x_(x), mu_(mu), sigma_(sigma)
+    MultivariateNormalLikelihiood(const T& x,  const U& mu,  const arma::mat& sigma): x_(x), mu_(mu), sigma_(sigma), R_(sigma.n_rows, sigma.n_cols), z_(x.n_elem)
     {
       // need a modified dimension check
       dimension_check(x_, mu_);
@@ -39,8 +42,9 @@ namespace cppbugs {
       }
     }
     inline double calc() const {
-      return multivariate_normal_sigma_logp(x_,mu_,sigma_);
+      return multivariate_normal_sigma_logp(x_,mu_,sigma_,R_,z_);
     }
+    void inputs(std::vector<const void*>& out) const { out.push_back(&x_); out.push_back(&mu_); out.push_back(&sigma_); }
   };
 
   template<typename T>
@@ -50,7 +54,7 @@ namespace cppbugs {
 
     template<typename U>
     MultivariateNormal<T>& dmvnorm(const U& mu, const arma::mat& sigma) {
-      Stochastic::likelihood_functor = new MultivariateNormalLikelihiood<T,U>(DynamicStochastic<T>::value,mu,sigma);
+      Stochastic::makeLikelihood<MultivariateNormalLikelihiood<T,U> >(DynamicStochastic<T>::value,mu,sigma);
       return *this;
     }
   };
@@ -62,7 +66,7 @@ namespace cppbugs {
 
     template<typename U>
     ObservedMultivariateNormal<T>& dmvnorm(const U& mu, const arma::mat& sigma) {
-      Stochastic::likelihood_functor = new MultivariateNormalLikelihiood<T,U>(Observed<T>::value,mu,sigma);
+      Stochastic::makeLikelihood<MultivariateNormalLikelihiood<T,U> >(Observed<T>::value,mu,sigma);
       return *this;
     }
   };
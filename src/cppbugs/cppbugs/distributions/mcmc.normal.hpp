@@ -29,11 +29,21 @@ namespace cppbugs {
     const T& x_;
     const U& mu_;
     const V& tau_;
+    mutable HyperTermCache cache_;
+    bool hyper_;
   public:
-    NormalLikelihiood(  const T& x,  const U& mu,  const V& tau): x_(x), mu_(mu), tau_(tau) { dimension_check(x_, mu_, tau_); }
+    NormalLikelihiood(  const T& x,  const U& mu,  const V& tau): x_(x), mu_(mu), tau_(tau), hyper_(true) { dimension_check(x_, mu_, tau_); }
     inline double calc() const {
-      return normal_logp(x_,mu_,tau_);
+      return normal_logp<default_math>(x_,mu_,tau_,0,terms(),&cache_,hyper_);
     }
+    size_t terms() const { return static_cast<size_t>(dim_size(x_)); }
+    // the cache is only needed for elementwise hyperparameters
+    void prepare() { cache_.prepare(is_scalar(tau_) ? 0 : terms()); }
+    double calc_terms(const size_t begin, const size_t end) const {
+      return normal_logp<default_math>(x_,mu_,tau_,begin,end,&cache_,hyper_);
+    }
+    void inputs(std::vector<const void*>& out) const { out.push_back(&x_); out.push_back(&mu_); out.push_back(&tau_); }
+    void dropConstants(const std::vector<bool>& fixed) { hyper_ = fixed.empty() || !(fixed[2]); }
   };
 
   template<typename T>
@@ -43,7 +53,7 @@ namespace cppbugs {
 
     template<typename U, typename V>
     Normal<T>& dnorm(const U& mu, const V& tau) {
-      Stochastic::likelihood_functor = new NormalLikelihiood<T,U,V>(DynamicStochastic<T>::value,mu,tau);
+      Stochastic::makeLikelihood<NormalLikelihiood<T,U,V> >(DynamicStochastic<T>::value,mu,tau);
       return *this;
     }
   };
@@ -55,7 +65,7 @@ namespace cppbugs {
 
     template<typename U, typename V>
     ObservedNormal<T>& dnorm(const U& mu, const V& tau) {
-      Stochastic::likelihood_functor = new NormalLikelihiood<T,U,V>(Observed<T>::value,mu,tau);
+      Stochastic::makeLikelihood<NormalLikelihiood<T,U,V> >(Observed<T>::value,mu,tau);
       return *this;
     }
   };
@@ -30,11 +30,18 @@ namespace cppbugs {
     const T& x_;
     const U& lower_;
     const V& upper_;
+    bool hyper_;
   public:
-    UniformLikelihiood(const T& x,  const U& lower,  const V& upper): x_(x), lower_(lower), upper_(upper) { dimension_check(x_, lower_, upper_); }
+    UniformLikelihiood(const T& x,  const U& lower,  const V& upper): x_(x), lower_(lower), upper_(upper), hyper_(true) { dimension_check(x_, lower_, upper_); }
     inline double calc() const {
-      return uniform_logp(x_,lower_,upper_);
+      return uniform_logp<default_math>(x_,lower_,upper_,0,terms(),hyper_);
     }
+    size_t terms() const { return static_cast<size_t>(dim_size(x_)); }
+    double calc_terms(const size_t begin, const size_t end) const {
+      return uniform_logp<default_math>(x_,lower_,upper_,begin,end,hyper_);
+    }
+    void inputs(std::vector<const void*>& out) const { out.push_back(&x_); out.push_back(&lower_); out.push_back(&upper_); }
+    void dropConstants(const std::vector<bool>& fixed) { hyper_ = fixed.empty() || !(fixed[1] && fixed[2]); }
   };
 
   template<typename T>
@@ -44,7 +51,7 @@ namespace cppbugs {
 
     template<typename U, typename V>
     Uniform<T>& dunif(const U& lower, const V& upper) {
-      Stochastic::likelihood_functor = new UniformLikelihiood<T,U,V>(DynamicStochastic<T>::value,lower,upper);
+      Stochastic::makeLikelihood<UniformLikelihiood<T,U,V> >(DynamicStochastic<T>::value,lower,upper);
       return *this;
     }
   };
@@ -56,7 +63,7 @@ namespace cppbugs {
 
     template<typename U, typename V>
     ObservedUniform<T>& dunif(const U& lower, const V& upper) {
-      Stochastic::likelihood_functor = new UniformLikelihiood<T,U,V>(Observed<T>::value,lower,upper);
+      Stochastic::makeLikelihood<UniformLikelihiood<T,U,V> >(Observed<T>::value,lower,upper);
       return *this;
     }
   };
@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_ARENA_HPP
+#define MCMC_ARENA_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+
+namespace cppbugs {
+
+  // bump allocator owned by a model
+  // nodes and likelihood functors are laid out next to each other in the
+  // order they are created, and everything is released in one go when the
+  // arena is destroyed (destructors run in reverse order of creation)
+  class Arena {
+  private:
+    struct Cleanup {
+      void* object;
+      void (*destroy)(void*);
+    };
+    // the least every allocation is aligned to; types which need more (arma
+    // members are over-aligned under -mavx and friends) get their own
+    static const size_t alignment = 16;
+    static const size_t default_chunk_size = 4096;
+
+    std::vector<char*> chunks_;
+    std::vector<Cleanup> cleanups_;
+    char* head_;
+    size_t remaining_;
+    size_t next_chunk_size_;
+
+    Arena(const Arena&);
+    Arena& operator=(const Arena&);
+
+    template<typename T>
+    static void destroy(void* p) { static_cast<T*>(p)->~T(); }
+
+    static size_t align_up(const size_t n) { return (n + alignment - 1) & ~(alignment - 1); }
+    // bytes to skip from p to the next multiple of align (a power of two)
+    static size_t padding(const char* p, const size_t align) {
+      return static_cast<size_t>(-reinterpret_cast<boost::uintptr_t>(p)) & (align - 1);
+    }
+
+    void grow(const size_t bytes) {
+      const size_t chunk_size = bytes > next_chunk_size_ ? bytes : next_chunk_size_;
+      char* chunk = static_cast<char*>(std::malloc(chunk_size));
+      if(chunk == NULL) { throw std::bad_alloc(); }
+      chunks_.push_back(chunk);
+      head_ = chunk;
+      remaining_ = chunk_size;
+      next_chunk_size_ *= 2;
+    }
+
+    // room for one more cleanup before the object is built, so adopt() cannot
+    // throw and leak a constructed object; grows geometrically (libstdc++
+    // reserves exactly what it is asked for)
+    void reserve_cleanup() {
+      if(cleanups_.size() == cleanups_.capacity()) { cleanups_.reserve(2 * cleanups_.size() + 1); }
+    }
+
+    template<typename T>
+    T* adopt(T* p) {
+      Cleanup c = { p, &destroy<T> };
+      cleanups_.push_back(c);
+      return p;
+    }
+  public:
+    Arena(): head_(NULL), remaining_(0), next_chunk_size_(default_chunk_size) {}
+    ~Arena() { clear(); }
+
+    // raw storage aligned to align, or to 16 bytes if that is more
+    void* allocate(const size_t bytes, const size_t align = alignment) {
+      const size_t a = align > alignment ? align : alignment;
+      const size_t n = align_up(bytes);
+      size_t pad = padding(head_, a);
+      if(pad + n > remaining_) {
+        // room for the worst padding, malloc makes no promise beyond max_align_t
+        grow(n + a - 1);
+        pad = padding(head_, a);
+      }
+      char* ans = head_ + pad;
+      head_ += pad + n;
+      remaining_ -= pad + n;
+      return ans;
+    }
+
+    // construct an object in the arena, it is destroyed along with the arena
+    template<typename T, typename A1>
+    T* create(A1& a1) {
+      void* mem = allocate(sizeof(T), boost::alignment_of<T>::value);
+      reserve_cleanup();
+      return adopt(new (mem) T(a1));
+    }
+
+    template<typename T, typename A1, typename A2>
+    T* create(const A1& a1, const A2& a2) {
+      void* mem = allocate(sizeof(T), boost::alignment_of<T>::value);
+      reserve_cleanup();
+      return adopt(new (mem) T(a1, a2));
+    }
+
+    template<typename T, typename A1, typename A2, typename A3>
+    T* create(const A1& a1, const A2& a2, const A3& a3) {
+      void* mem = allocate(sizeof(T), boost::alignment_of<T>::value);
+      reserve_cleanup();
+      return adopt(new (mem) T(a1, a2, a3));
+    }
+
+    void clear() {
+      for(std::vector<Cleanup>::reverse_iterator it = cleanups_.rbegin(); it != cleanups_.rend(); it++) {
+        it->destroy(it->object);
+      }
+      cleanups_.clear();
+      for(std::vector<char*>::iterator it = chunks_.begin(); it != chunks_.end(); it++) {
+        std::free(*it);
+      }
+      chunks_.clear();
+      head_ = NULL;
+      remaining_ = 0;
+      next_chunk_size_ = default_chunk_size;
+    }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_ARENA_HPP
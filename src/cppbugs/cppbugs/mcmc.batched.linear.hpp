@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_BATCHED_LINEAR_HPP
+#define MCMC_BATCHED_LINEAR_HPP
+
+#include <cstring>
+#include <stdexcept>
+#include <mutex>
+#include <condition_variable>
+#include <armadillo>
+
+namespace cppbugs {
+
+  // linear predictor shared by K chains with the same design matrix
+  // each chain calls predict() from its update(), the last one to arrive
+  // computes X * [b_1 ... b_K] as a single matrix product (X is read once
+  // instead of K times) and every chain gets its own column back
+  //
+  // chains run on their own threads and in lockstep: they must make the same
+  // sequence of update() calls, which they do when they are the same model
+  // sampled with the same iterations/burn/adapt/thin
+  // a chain which stops early (or throws) must call leave(), otherwise the
+  // others wait for it; hold a BatchedChain (below) for the chain's lifetime
+  // so that happens on every way out of sample()
+  class BatchedLinearPredictor {
+  private:
+    const arma::mat& X_;
+    arma::mat B_, Y_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    size_t chains_, arrived_;
+    unsigned long generation_;
+
+    BatchedLinearPredictor(const BatchedLinearPredictor&);
+    BatchedLinearPredictor& operator=(const BatchedLinearPredictor&);
+
+    // caller holds mutex_
+    void release() {
+      Y_ = X_ * B_;
+      arrived_ = 0;
+      ++generation_;
+      ready_.notify_all();
+    }
+  public:
+    BatchedLinearPredictor(const arma::mat& X, const size_t chains): X_(X), B_(X.n_cols, chains), Y_(X.n_rows, chains), chains_(chains), arrived_(0), generation_(0) {
+      B_.fill(0);
+    }
+
+    // out = X * b for chain k (0 <= k < chains)
+    void predict(const size_t k, const arma::vec& b, arma::mat& out) {
+      if(b.n_elem != X_.n_cols) {
+        throw std::logic_error("ERROR: BatchedLinearPredictor, length of b does not match number of columns of X.");
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      memcpy(B_.colptr(k), b.memptr(), sizeof(double) * b.n_elem);
+      const unsigned long generation = generation_;
+      if(++arrived_ == chains_) {
+        release();
+      } else {
+        ready_.wait(lock, [&]() { return generation_ != generation; });
+      }
+      out.set_size(X_.n_rows, 1);
+      memcpy(out.memptr(), Y_.colptr(k), sizeof(double) * X_.n_rows);
+    }
+
+    // chain k takes no further part; its column keeps its last b
+    void leave(const size_t k) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --chains_;
+      if(chains_ && arrived_ == chains_) { release(); }
+    }
+  };
+
+  // leave()s the batch when it goes out of scope, also when sample() throws
+  // batch may be NULL, for a chain which is run on its own
+  class BatchedChain {
+  private:
+    BatchedLinearPredictor* batch_;
+    size_t k_;
+    BatchedChain(const BatchedChain&);
+    BatchedChain& operator=(const BatchedChain&);
+  public:
+    BatchedChain(BatchedLinearPredictor* batch, const size_t k): batch_(batch), k_(k) {}
+    ~BatchedChain() { if(batch_) { batch_->leave(k_); } }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_BATCHED_LINEAR_HPP
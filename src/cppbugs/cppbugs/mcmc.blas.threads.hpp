@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_BLAS_THREADS_HPP
+#define MCMC_BLAS_THREADS_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <cppbugs/mcmc.thread.pool.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CPPBUGS_HAVE_DLSYM
+#include <dlfcn.h>
+#endif
+
+namespace cppbugs {
+
+  // the thread count of whatever blas the process is linked against, looked
+  // up by symbol at run time since neither R nor armadillo tells us which one it is
+  // openblas and blis set it process wide, mkl for the calling thread only
+  namespace blas_detail {
+    typedef void (*set_fn)(int);
+    typedef int (*get_fn)();
+
+    inline void* symbol(const char* name) {
+#ifdef CPPBUGS_HAVE_DLSYM
+      return dlsym(RTLD_DEFAULT, name);
+#else
+      return NULL;
+#endif
+    }
+
+    template<typename F>
+    F function(const char* name) {
+      F f;
+      void* p = symbol(name);
+      memcpy(&f, &p, sizeof(f));
+      return f;
+    }
+  }
+
+  // -1 if no known blas is loaded
+  inline int blas_threads() {
+    using namespace blas_detail;
+    const char* getters[] = { "MKL_Get_Max_Threads", "openblas_get_num_threads", "bli_thread_get_num_threads" };
+    for(size_t i = 0; i < sizeof(getters) / sizeof(getters[0]); i++) {
+      get_fn f = function<get_fn>(getters[i]);
+      if(f) { return f(); }
+    }
+    return -1;
+  }
+
+  // for the calling thread only, so each chain can set its own share; false
+  // unless the blas supports that (mkl)
+  inline bool set_blas_threads_local(const int n) {
+    using namespace blas_detail;
+    typedef int (*mkl_local_fn)(int);
+    mkl_local_fn mkl_local = function<mkl_local_fn>("MKL_Set_Num_Threads_Local");
+    if(mkl_local) { mkl_local(n); return true; }
+    return false;
+  }
+
+  // process wide for openblas, blis and goto: call it once from the driver
+  // before the chains start, never from the chains themselves (the calls
+  // would race and the last one win); false if no known blas is loaded
+  inline bool set_blas_threads(const int n) {
+    using namespace blas_detail;
+    if(set_blas_threads_local(n)) { return true; }
+    const char* setters[] = { "openblas_set_num_threads", "bli_thread_set_num_threads", "goto_set_num_threads" };
+    for(size_t i = 0; i < sizeof(setters) / sizeof(setters[0]); i++) {
+      set_fn f = function<set_fn>(setters[i]);
+      if(f) { f(n); return true; }
+    }
+    return false;
+  }
+
+  // how the cores are shared out when chains run side by side
+  // each chain gets an equal share, which its likelihood pool and blas both
+  // use: update() and logp() never overlap within a chain, so the two can
+  // have the same cores without oversubscribing them
+  struct ThreadSplit {
+    size_t chains, likelihood;
+    int blas;
+  };
+
+  inline ThreadSplit split_threads(const size_t chains, const size_t cores = ThreadBudget::hardware()) {
+    ThreadSplit ans;
+    ans.chains = std::max<size_t>(chains, 1);
+    ans.likelihood = std::max<size_t>(cores / ans.chains, 1);
+    ans.blas = static_cast<int>(ans.likelihood);
+    return ans;
+  }
+
+} // namespace cppbugs
+#endif // MCMC_BLAS_THREADS_HPP
@@ -24,14 +24,30 @@ namespace cppbugs {
 
   template<typename T>
   class Deterministic : public Dynamic<T> {
+  private:
+    bool double_buffered_;
   public:
-    Deterministic(T& value): Dynamic<T>(value) {}
+    Deterministic(T& value): Dynamic<T>(value), double_buffered_(false) {}
     void jump(RngBase& rng) {}
     void accept() {}
     void reject(){}
     void tune() {}
-    // in Dynamic: void preserve()
-    // in Dynamic: void revert()
+    // preserve copies, so an update which writes only part of the value
+    // (y_hat.col(0) = ..., +=, conditional writes) still starts from the current one
+    // double buffered: the value is always fully recomputed after a preserve,
+    // so the new value is written into the inactive buffer and revert swaps back
+    // (values in memory the node does not own are still copied, see swappable)
+    void preserve() {
+      if(swapping()) { Dynamic<T>::swap_values(Dynamic<T>::value, Dynamic<T>::old_value); }
+      else { Dynamic<T>::preserve(); }
+    }
+    void revert() {
+      if(swapping()) { Dynamic<T>::swap_values(Dynamic<T>::value, Dynamic<T>::old_value); }
+      else { Dynamic<T>::revert(); }
+    }
+    void setDoubleBuffered(const bool double_buffered) { double_buffered_ = double_buffered; }
+    // true if preserve and revert swap the buffers rather than copy one into the other
+    bool swapping() const { return double_buffered_ && Dynamic<T>::swappable(Dynamic<T>::value, Dynamic<T>::old_value); }
     // in Dynamic: void tally()
     bool isDeterministc() const { return true; }
     bool isStochastic() const { return false; }
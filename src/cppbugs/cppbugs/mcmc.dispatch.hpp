@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_DISPATCH_HPP
+#define MCMC_DISPATCH_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+// the package is built for baseline x86-64, so the hot kernels are compiled
+// a second and third time for avx2 and avx512f and picked by cpuid when
+// first used; define CPPBUGS_NO_DISPATCH to build the baseline kernels only
+// the environment variable CPPBUGS_ISA (baseline, avx2, avx512f) caps the choice
+// gcc only, since the variants must not contract to fma (see mcmc.kernels.hpp)
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__)) && !defined(CPPBUGS_NO_DISPATCH)
+#define CPPBUGS_KERNEL_DISPATCH
+#endif
+
+#if defined(__GNUC__)
+#define CPPBUGS_RESTRICT __restrict__
+#else
+#define CPPBUGS_RESTRICT
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+#define CPPBUGS_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+#define CPPBUGS_NO_CONTRACT
+#endif
+
+namespace cppbugs {
+
+#define CPPBUGS_KERNEL_NS baseline_kernels
+#define CPPBUGS_KERNEL_ATTR CPPBUGS_NO_CONTRACT
+#include <cppbugs/mcmc.kernels.hpp>
+#undef CPPBUGS_KERNEL_NS
+#undef CPPBUGS_KERNEL_ATTR
+
+#ifdef CPPBUGS_KERNEL_DISPATCH
+#define CPPBUGS_KERNEL_NS avx2_kernels
+#define CPPBUGS_KERNEL_ATTR __attribute__((target("avx2"))) CPPBUGS_NO_CONTRACT
+#include <cppbugs/mcmc.kernels.hpp>
+#undef CPPBUGS_KERNEL_NS
+#undef CPPBUGS_KERNEL_ATTR
+
+#define CPPBUGS_KERNEL_NS avx512f_kernels
+#define CPPBUGS_KERNEL_ATTR __attribute__((target("avx512f"))) CPPBUGS_NO_CONTRACT
+#include <cppbugs/mcmc.kernels.hpp>
+#undef CPPBUGS_KERNEL_NS
+#undef CPPBUGS_KERNEL_ATTR
+#endif
+
+  struct kernel_table {
+    const char* isa;
+    double (*sum_sq_diff)(const double* x, const double* mu, const size_t n);
+    void (*axpy)(double* CPPBUGS_RESTRICT y, const double a, const double* CPPBUGS_RESTRICT x, const size_t n);
+  };
+
+  // fills out with the kernels for isa, false if they are not built or this cpu lacks them
+  inline bool kernels_for(const char* isa, kernel_table& out) {
+    if(strcmp(isa, "baseline") == 0) {
+      out.isa = "baseline";
+      out.sum_sq_diff = baseline_kernels::sum_sq_diff;
+      out.axpy = baseline_kernels::axpy;
+      return true;
+    }
+#ifdef CPPBUGS_KERNEL_DISPATCH
+    __builtin_cpu_init();
+    if(strcmp(isa, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+      out.isa = "avx2";
+      out.sum_sq_diff = avx2_kernels::sum_sq_diff;
+      out.axpy = avx2_kernels::axpy;
+      return true;
+    }
+    if(strcmp(isa, "avx512f") == 0 && __builtin_cpu_supports("avx512f")) {
+      out.isa = "avx512f";
+      out.sum_sq_diff = avx512f_kernels::sum_sq_diff;
+      out.axpy = avx512f_kernels::axpy;
+      return true;
+    }
+#endif
+    return false;
+  }
+
+  // best level this cpu supports, not above CPPBUGS_ISA when that is set
+  inline kernel_table select_kernels() {
+    static const char* const levels[] = { "baseline", "avx2", "avx512f" };
+    const size_t n_levels = sizeof(levels) / sizeof(levels[0]);
+    const char* cap = getenv("CPPBUGS_ISA");
+    size_t top = n_levels - 1;
+    for(size_t i = 0; cap && i < n_levels; i++) {
+      if(strcmp(cap, levels[i]) == 0) { top = i; }
+    }
+    kernel_table ans;
+    for(size_t i = top + 1; i-- > 0; ) {
+      if(kernels_for(levels[i], ans)) { break; }
+    }
+    return ans;
+  }
+
+  inline const kernel_table& kernels() {
+    static const kernel_table table = select_kernels();
+    return table;
+  }
+
+} // namespace cppbugs
+#endif // MCMC_DISPATCH_HPP
@@ -19,11 +19,24 @@
 #define MCMC_DYNAMIC_HPP
 
 #include <list>
+#include <new>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 #include <cppbugs/mcmc.specialized.hpp>
 #include <cppbugs/mcmc.math.hpp>
 
 namespace cppbugs {
 
+  // value types which can live inside a FlatState
+  template<typename T> struct flattenable { static const bool value = false; };
+  template<> struct flattenable<double> { static const bool value = true; };
+  template<> struct flattenable<arma::vec> { static const bool value = true; };
+  template<> struct flattenable<arma::mat> { static const bool value = true; };
+
+  template<typename T>
+  void destroy_in_place(T& x) { x.~T(); }
+
   template<typename T>
   class Dynamic : public MCMCSpecialized<T> {
   public:
@@ -37,8 +50,57 @@ namespace cppbugs {
 
     void preserve() { old_value = value; }
     void revert() { value = old_value; }
+
+    // exchange buffers without copying (owned arma memory is swapped by pointer)
+    static void swap_values(double& a, double& b) { std::swap(a, b); }
+    static void swap_values(int& a, int& b) { std::swap(a, b); }
+    template<typename eT>
+    static void swap_values(arma::Mat<eT>& a, arma::Mat<eT>& b) { a.swap(b); }
+    // whether swap_values is cheaper than a copy: arma swaps memory it does
+    // not own (R's, a flat state's) element by element, reading and writing
+    // both buffers, which costs twice the copy it would replace
+    static bool swappable(const double& a, const double& b) { return true; }
+    static bool swappable(const int& a, const int& b) { return true; }
+    template<typename eT>
+    static bool swappable(const arma::Mat<eT>& a, const arma::Mat<eT>& b) { return a.mem_state == 0 && b.mem_state == 0; }
     void tally() { if(MCMCSpecialized<T>::save_history_) { MCMCSpecialized<T>::history.push_back(value); } }
     double size() const { return dim_size(value); }
+    const void* valueAddress() const { return &value; }
+
+    // arma values are rebuilt as views on mem, scalars are copied in and
+    // returned so the owner can mirror the flat state back into them
+    static double* bind_flat(double& x, double* mem) { *mem = x; return &x; }
+    static double* bind_flat(arma::vec& x, double* mem) {
+      const arma::uword n = x.n_elem;
+      memcpy(mem, x.memptr(), sizeof(double) * n);
+      destroy_in_place(x);
+      new (&x) arma::vec(mem, n, false, true);
+      return NULL;
+    }
+    static double* bind_flat(arma::mat& x, double* mem) {
+      const arma::uword nr = x.n_rows, nc = x.n_cols;
+      memcpy(mem, x.memptr(), sizeof(double) * nr * nc);
+      destroy_in_place(x);
+      new (&x) arma::mat(mem, nr, nc, false, true);
+      return NULL;
+    }
+    template<typename U>
+    static double* bind_flat(U& x, double* mem) { throw std::logic_error("ERROR: node type cannot be flattened."); }
+
+    // give the value its own memory back
+    template<typename M>
+    static void release_arma(M& x) {
+      const M tmp(x);
+      destroy_in_place(x);
+      new (&x) M(tmp);
+    }
+    static void release_flat(arma::vec& x) { release_arma(x); }
+    static void release_flat(arma::mat& x) { release_arma(x); }
+    template<typename U>
+    static void release_flat(U& x) {}
+
+    double* bindFlat(double* mem) { return bind_flat(value, mem); }
+    void releaseFlat() { release_flat(value); }
   };
 
 } // namespace cppbugs
@@ -67,6 +67,11 @@ namespace cppbugs {
     bool isObserved() const { return false; }
     void setScale(const double scale) { scale_ = scale; }
     double getScale() const { return scale_; }
+    bool jumpBounds(double& lower, double& upper) const {
+      lower = -std::numeric_limits<double>::infinity();
+      upper = std::numeric_limits<double>::infinity();
+      return flattenable<T>::value;
+    }
   };
 
 } // namespace cppbugs
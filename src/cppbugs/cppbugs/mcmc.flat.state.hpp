@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_FLAT_STATE_HPP
+#define MCMC_FLAT_STATE_HPP
+
+#include <vector>
+#include <cstring>
+#include <armadillo>
+#include <cppbugs/mcmc.object.hpp>
+#include <cppbugs/mcmc.rng.base.hpp>
+
+namespace cppbugs {
+
+  // all free parameters of a model packed into one contiguous block
+  // arma valued nodes are bound as views into the block, scalar nodes
+  // keep their own storage and are mirrored in and out of it
+  // preserve/revert become a single memcpy and jump a single pass
+  class FlatState {
+  private:
+    std::vector<MCMCObject*> nodes_;
+    std::vector<arma::uword> offsets_;
+    std::vector<double*> scalars_;
+    std::vector<arma::uword> scalar_offsets_;
+    arma::vec state_, saved_, scale_, lower_, upper_;
+    // proposal noise, drawn for the whole block in one call
+    arma::vec noise_;
+
+    void gather() { for(size_t i = 0; i < scalars_.size(); i++) { state_[scalar_offsets_[i]] = *scalars_[i]; } }
+    void scatter() { for(size_t i = 0; i < scalars_.size(); i++) { *scalars_[i] = state_[scalar_offsets_[i]]; } }
+  public:
+    // owner must call release() while the nodes are still alive
+    FlatState() {}
+
+    // nodes must have returned true from jumpBounds
+    void bind(const std::vector<MCMCObject*>& nodes) {
+      release();
+      arma::uword total = 0;
+      for(size_t i = 0; i < nodes.size(); i++) {
+        offsets_.push_back(total);
+        total += static_cast<arma::uword>(nodes[i]->size());
+      }
+
+      // allocated once, views keep pointing into it until release
+      state_.set_size(total);
+      saved_.set_size(total);
+      scale_.set_size(total);
+      lower_.set_size(total);
+      upper_.set_size(total);
+      noise_.set_size(total);
+
+      for(size_t i = 0; i < nodes.size(); i++) {
+        const arma::uword end = (i + 1 < nodes.size()) ? offsets_[i + 1] : total;
+        double lower, upper;
+        nodes[i]->jumpBounds(lower, upper);
+        for(arma::uword j = offsets_[i]; j < end; j++) {
+          lower_[j] = lower;
+          upper_[j] = upper;
+        }
+        double* scalar = nodes[i]->bindFlat(state_.memptr() + offsets_[i]);
+        if(scalar) {
+          scalars_.push_back(scalar);
+          scalar_offsets_.push_back(offsets_[i]);
+        }
+        nodes_.push_back(nodes[i]);
+      }
+      syncScales();
+    }
+
+    void release() {
+      for(size_t i = 0; i < nodes_.size(); i++) {
+        nodes_[i]->releaseFlat();
+      }
+      nodes_.clear();
+      offsets_.clear();
+      scalars_.clear();
+      scalar_offsets_.clear();
+    }
+
+    // must be called whenever the nodes' scales are tuned
+    void syncScales() {
+      for(size_t i = 0; i < nodes_.size(); i++) {
+        const arma::uword end = (i + 1 < nodes_.size()) ? offsets_[i + 1] : state_.n_elem;
+        const double scale = nodes_[i]->getScale();
+        for(arma::uword j = offsets_[i]; j < end; j++) {
+          scale_[j] = scale;
+        }
+      }
+    }
+
+    // scalars may have been moved by a per node jump (tune), so pull them in first
+    void preserve() {
+      if(nodes_.empty()) { return; }
+      gather();
+      memcpy(saved_.memptr(), state_.memptr(), sizeof(double) * state_.n_elem);
+    }
+
+    void revert() {
+      if(nodes_.empty()) { return; }
+      memcpy(state_.memptr(), saved_.memptr(), sizeof(double) * state_.n_elem);
+      scatter();
+    }
+
+    // random walk over the whole block, redrawing any coordinate which leaves its (open) support
+    void jump(RngBase& rng) {
+      if(nodes_.empty()) { return; }
+      double* x = state_.memptr();
+      const double* z = noise_.memptr();
+      const double* scale = scale_.memptr();
+      const double* lower = lower_.memptr();
+      const double* upper = upper_.memptr();
+      rng.fill_normal(noise_.memptr(), noise_.n_elem);
+      for(arma::uword i = 0; i < state_.n_elem; i++) {
+        double v = x[i] + z[i] * scale[i];
+        while(v <= lower[i] || v >= upper[i]) {
+          v = x[i] + rng.normal() * scale[i];
+        }
+        x[i] = v;
+      }
+      scatter();
+    }
+
+    bool empty() const { return nodes_.empty(); }
+    arma::uword size() const { return nodes_.empty() ? 0 : state_.n_elem; }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_FLAT_STATE_HPP
@@ -15,7 +15,11 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>. //
 ///////////////////////////////////////////////////////////////////////////
 
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
 #include <cppbugs/mcmc.rng.base.hpp>
+#include <cppbugs/mcmc.dispatch.hpp>
 
 #ifndef MCMC_JUMP_HPP
 #define MCMC_JUMP_HPP
@@ -49,24 +53,65 @@ namespace cppbugs {
     value = new_value;
   }
 
+  // vector jumps draw their proposals a block at a time through the bulk rng interface
+  // coordinates which leave their support are redrawn one at a time as before
+  static const size_t jump_block_size = 256;
+
+  inline void add_jump(double& value, const double delta) { value += delta; }
+  inline void add_jump(int& value, const double delta) { value += lrint(delta); }
+
+  template<typename eT>
+  void add_jump_block(eT* value, const double* z, const double scale, const size_t n) {
+    for(size_t j = 0; j < n; j++) {
+      add_jump(value[j], z[j] * scale);
+    }
+  }
+
+  inline void add_jump_block(double* value, const double* z, const double scale, const size_t n) {
+    kernels().axpy(value, scale, z, n);
+  }
+
   template<typename T>
   void jump_impl(RngBase& rng, T& value, const double scale) {
-    for(size_t i = 0; i < value.n_elem; i++) {
-      jump_impl(rng, value[i], scale);
+    double z[jump_block_size];
+    for(size_t i = 0; i < value.n_elem; i += jump_block_size) {
+      const size_t n = std::min<size_t>(jump_block_size, value.n_elem - i);
+      rng.fill_normal(z, n);
+      add_jump_block(value.memptr() + i, z, scale, n);
     }
   }
 
   template<typename T>
   void positive_jump_impl(RngBase& rng, T& value, const double scale) {
-    for(size_t i = 0; i < value.n_elem; i++) {
-      positive_jump_impl(rng, value[i], scale);
+    double z[jump_block_size];
+    for(size_t i = 0; i < value.n_elem; i += jump_block_size) {
+      const size_t n = std::min<size_t>(jump_block_size, value.n_elem - i);
+      rng.fill_normal(z, n);
+      for(size_t j = 0; j < n; j++) {
+        const double new_value = value[i + j] + z[j] * scale;
+        if(new_value < 0) {
+          positive_jump_impl(rng, value[i + j], scale);
+        } else {
+          value[i + j] = new_value;
+        }
+      }
     }
   }
 
   template<typename T>
   void bounded_jump_impl(RngBase& rng, T& value, const double scale, const double lower, const double upper) {
-    for(size_t i = 0; i < value.n_elem; i++) {
-      bounded_jump_impl(rng, value[i], scale, lower, upper);
+    double z[jump_block_size];
+    for(size_t i = 0; i < value.n_elem; i += jump_block_size) {
+      const size_t n = std::min<size_t>(jump_block_size, value.n_elem - i);
+      rng.fill_normal(z, n);
+      for(size_t j = 0; j < n; j++) {
+        const double new_value = value[i + j] + z[j] * scale;
+        if(new_value <= lower || new_value >= upper) {
+          bounded_jump_impl(rng, value[i + j], scale, lower, upper);
+        } else {
+          value[i + j] = new_value;
+        }
+      }
     }
   }
 
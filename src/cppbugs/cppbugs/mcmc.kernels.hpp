@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+// kernel bodies, compiled once per isa level by mcmc.dispatch.hpp
+// there is deliberately no include guard: the includer defines
+// CPPBUGS_KERNEL_NS and CPPBUGS_KERNEL_ATTR before each inclusion
+//
+// every variant accumulates in the same eight lanes and combines them in the
+// same order, and contraction to fma is switched off, so all isa levels
+// return bit-identical results and a seeded chain does not depend on the host
+
+namespace CPPBUGS_KERNEL_NS {
+
+  // sum((x - mu)^2)
+  CPPBUGS_KERNEL_ATTR inline double sum_sq_diff(const double* x, const double* mu, const size_t n) {
+    double acc[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+      for(size_t k = 0; k < 8; k++) {
+        const double d = x[i + k] - mu[i + k];
+        acc[k] += d * d;
+      }
+    }
+    for(size_t k = 0; i < n; i++, k++) {
+      const double d = x[i] - mu[i];
+      acc[k] += d * d;
+    }
+    return ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+  }
+
+  // y += a * x
+  CPPBUGS_KERNEL_ATTR inline void axpy(double* CPPBUGS_RESTRICT y, const double a, const double* CPPBUGS_RESTRICT x, const size_t n) {
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+      for(size_t k = 0; k < 8; k++) {
+        y[i + k] += a * x[i + k];
+      }
+    }
+    for(; i < n; i++) {
+      y[i] += a * x[i];
+    }
+  }
+
+} // namespace CPPBUGS_KERNEL_NS
@@ -0,0 +1,250 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_LIKELIHOOD_REDUCER_HPP
+#define MCMC_LIKELIHOOD_REDUCER_HPP
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <limits>
+#include <cppbugs/mcmc.stochastic.hpp>
+#include <cppbugs/mcmc.thread.pool.hpp>
+#include <cppbugs/mcmc.model.graph.hpp>
+
+namespace cppbugs {
+
+  // likelihoods with more terms than this are summed block by block
+  static const size_t likelihood_block_size = 65536;
+
+  // small likelihoods are packed into tasks of at least this many terms,
+  // so that handing a task to a worker costs less than evaluating it
+  static const size_t likelihood_task_size = 4096;
+
+  // likelihoods of at most this many terms (scalar priors and the like) are
+  // evaluated on the caller before anything is handed to the pool, so that a
+  // proposal outside a prior's support is rejected at the cost of a few terms
+  static const size_t likelihood_cheap_size = 64;
+
+  // the order a set of likelihood functors is evaluated in, cheapest first
+  // (cost is estimated as the number of terms): cheap ones (at most
+  // likelihood_cheap_size terms) run on the caller, mid sized ones are packed
+  // into pool tasks of roughly likelihood_task_size terms (task_ends holds
+  // where each task ends in mid) and large ones are split into blocks
+  struct LikelihoodPlan {
+    std::vector<size_t> cheap, mid, large, task_ends;
+  };
+
+  // evaluates likelihood functors, splitting large ones into fixed blocks
+  // and running independent ones as tasks, both over a thread pool (when
+  // there is one)
+  // block boundaries do not depend on the number of threads and the partials
+  // are added in block order, so the result is the same for any pool size
+  class LikelihoodReducer {
+  private:
+    ThreadPool* pool_;
+    mutable std::vector<double> partials_;
+
+    class BlockTask : public ThreadTask {
+      const Likelihiood& f_;
+      const size_t n_;
+      double* partials_;
+    public:
+      BlockTask(const Likelihiood& f, const size_t n, double* partials): f_(f), n_(n), partials_(partials) {}
+      void operator()(const size_t b) const {
+        const size_t begin = b * likelihood_block_size;
+        partials_[b] = f_.calc_terms(begin, std::min(n_, begin + likelihood_block_size));
+      }
+    };
+
+    // the plan of every functor of one logp(), and a slot for each
+    LikelihoodPlan plan_;
+    mutable std::vector<double> values_;
+
+    // setTiming(): time spent in and evaluations of each functor, by its
+    // index in fs (a task only writes the slots of its own functors)
+    bool timing_;
+    mutable std::vector<double> times_;
+    mutable std::vector<size_t> counts_;
+
+    class FunctorTask : public ThreadTask {
+      const LikelihoodReducer& reducer_;
+      const std::vector<Likelihiood*>& fs_;
+      const LikelihoodPlan& plan_;
+      double* values_;
+    public:
+      FunctorTask(const LikelihoodReducer& reducer, const std::vector<Likelihiood*>& fs, const LikelihoodPlan& plan, double* values):
+        reducer_(reducer), fs_(fs), plan_(plan), values_(values) {}
+      void operator()(const size_t t) const {
+        for(size_t k = t ? plan_.task_ends[t - 1] : 0; k < plan_.task_ends[t]; k++) {
+          values_[plan_.mid[k]] = reducer_.timed(fs_, plan_.mid[k], false);
+        }
+      }
+    };
+
+    // fs[i] evaluated whole, or split into blocks
+    double timed(const std::vector<Likelihiood*>& fs, const size_t i, const bool blocks) const {
+      if(!timing_) { return blocks ? calc(*fs[i]) : fs[i]->calc(); }
+      const double t0 = profile_clock();
+      const double ans = blocks ? calc(*fs[i]) : fs[i]->calc();
+      times_[i] += profile_clock() - t0;
+      counts_[i]++;
+      return ans;
+    }
+
+    static size_t cost(const Likelihiood& f) { return std::max<size_t>(f.terms(), 1); }
+    static bool bad(const double value) { return value != value || value == -std::numeric_limits<double>::infinity(); }
+
+    class CostOrder {
+      const std::vector<Likelihiood*>& fs_;
+    public:
+      CostOrder(const std::vector<Likelihiood*>& fs): fs_(fs) {}
+      bool operator()(const size_t a, const size_t b) const { return cost(*fs_[a]) < cost(*fs_[b]); }
+    };
+  public:
+    LikelihoodReducer(): pool_(NULL), timing_(false) {}
+    void setPool(ThreadPool* pool) { pool_ = pool; }
+
+    // times every functor evaluate() runs, in the order, threads and with the
+    // short-circuit it runs them with anyway; a functor split into blocks is
+    // timed as a whole
+    // clears the timings, which plan(fs) also does
+    void setTiming(const bool timing) {
+      timing_ = timing;
+      times_.assign(values_.size(), 0);
+      counts_.assign(values_.size(), 0);
+    }
+    // seconds spent in and evaluations of fs[i] since the timings were cleared
+    double time(const size_t i) const { return i < times_.size() ? times_[i] : 0; }
+    size_t count(const size_t i) const { return i < counts_.size() ? counts_[i] : 0; }
+
+    // prepares, orders and groups the functors of a model, must be called
+    // again whenever the set of functors changes
+    void plan(const std::vector<Likelihiood*>& fs) {
+      for(size_t i = 0; i < fs.size(); i++) { fs[i]->prepare(); }
+      std::vector<size_t> all(fs.size());
+      for(size_t i = 0; i < fs.size(); i++) { all[i] = i; }
+      plan_ = plan(fs, all);
+      values_.assign(fs.size(), 0);
+      setTiming(timing_);
+    }
+
+    // the plan for the functors fs[subset[k]] only (e.g. those one node's
+    // jump touches), which must have been prepared already
+    LikelihoodPlan plan(const std::vector<Likelihiood*>& fs, const std::vector<size_t>& subset) const {
+      std::vector<size_t> order(subset);
+      std::stable_sort(order.begin(), order.end(), CostOrder(fs));
+
+      LikelihoodPlan ans;
+      size_t task_cost = 0;
+      for(size_t k = 0; k < order.size(); k++) {
+        const size_t i = order[k];
+        const size_t c = cost(*fs[i]);
+        if(c <= likelihood_cheap_size) {
+          ans.cheap.push_back(i);
+        } else if(c <= likelihood_block_size) {
+          ans.mid.push_back(i);
+          task_cost += c;
+          if(task_cost >= likelihood_task_size) {
+            ans.task_ends.push_back(ans.mid.size());
+            task_cost = 0;
+          }
+        } else {
+          ans.large.push_back(i);
+        }
+      }
+      if(task_cost) { ans.task_ends.push_back(ans.mid.size()); }
+      return ans;
+    }
+
+    // the plan of every functor, as set by plan(fs)
+    const LikelihoodPlan& modelPlan() const { return plan_; }
+
+    // evaluates the functors of p into values[i], cheapest first, and returns
+    // the first -inf (or NaN) met, 0 when there is none; with stop the rest
+    // of p is then left unevaluated, so a proposal outside a prior's support
+    // never pays for a pass over the data
+    double evaluate(const std::vector<Likelihiood*>& fs, const LikelihoodPlan& p, double* values, const bool stop = true) const {
+      double ans(0);
+      for(size_t k = 0; k < p.cheap.size(); k++) {
+        const size_t i = p.cheap[k];
+        values[i] = timed(fs, i, false);
+        if(bad(values[i]) && !bad(ans)) { ans = values[i]; if(stop) { return ans; } }
+      }
+
+      if(pool_ && pool_->size() > 1 && p.task_ends.size() > 1) {
+        FunctorTask task(*this, fs, p, values);
+        pool_->run(task, p.task_ends.size());
+        for(size_t k = 0; k < p.mid.size(); k++) {
+          if(bad(values[p.mid[k]]) && !bad(ans)) { ans = values[p.mid[k]]; if(stop) { return ans; } }
+        }
+      } else {
+        for(size_t k = 0; k < p.mid.size(); k++) {
+          const size_t i = p.mid[k];
+          values[i] = timed(fs, i, false);
+          if(bad(values[i]) && !bad(ans)) { ans = values[i]; if(stop) { return ans; } }
+        }
+      }
+
+      for(size_t k = 0; k < p.large.size(); k++) {
+        const size_t i = p.large[k];
+        values[i] = timed(fs, i, true);
+        if(bad(values[i]) && !bad(ans)) { ans = values[i]; if(stop) { return ans; } }
+      }
+      return ans;
+    }
+
+    // sum of all functors, evaluated as planned and abandoned at the first
+    // -inf (or NaN)
+    // every functor lands in its own slot and the slots are added in model
+    // order, which is the order a plain loop over the functors adds them in
+    double sum(const std::vector<Likelihiood*>& fs) const {
+      double ans(0);
+      if(values_.size() != fs.size()) {
+        for(size_t i = 0; i < fs.size(); i++) { ans += calc(*fs[i]); }
+        return ans;
+      }
+      if(fs.empty()) { return ans; }
+
+      const double status = evaluate(fs, plan_, &values_[0]);
+      if(bad(status)) { return status; }
+      for(size_t i = 0; i < fs.size(); i++) { ans += values_[i]; }
+      return ans;
+    }
+
+    double calc(const Likelihiood& f) const {
+      const size_t n = f.terms();
+      if(n <= likelihood_block_size) { return f.calc(); }
+
+      // grows once to the largest likelihood, never in the steady state
+      const size_t n_blocks = (n + likelihood_block_size - 1) / likelihood_block_size;
+      if(partials_.size() < n_blocks) { partials_.resize(n_blocks); }
+      BlockTask task(f, n, &partials_[0]);
+      if(pool_) {
+        pool_->run(task, n_blocks);
+      } else {
+        for(size_t b = 0; b < n_blocks; b++) { task(b); }
+      }
+
+      double ans(0);
+      for(size_t b = 0; b < n_blocks; b++) { ans += partials_[b]; }
+      return ans;
+    }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_LIKELIHOOD_REDUCER_HPP
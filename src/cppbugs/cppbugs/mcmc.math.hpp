@@ -19,10 +19,16 @@
 #define MCMC_MATH_HPP
 
 #include <stdexcept>
+#include <vector>
 #include <cmath>
+#include <cstring>
+#include <limits>
+#include <boost/cstdint.hpp>
 #include <armadillo>
 #include <boost/math/special_functions/gamma.hpp>
+#include <boost/math/special_functions/log1p.hpp>
 #include <boost/math/special_functions/factorials.hpp>
+#include <cppbugs/mcmc.dispatch.hpp>
 
 namespace cppbugs {
 
@@ -64,38 +70,86 @@ namespace cppbugs {
   ////////////////////////////////////////////////////////////////////////////////////
 
 
+  // lookup tables are immutable and cache line aligned; each is built exactly once,
+  // on first use or eagerly by warm_math_tables() when a model is constructed, and
+  // is read only afterwards, so concurrent chains can share them without locking
+#if defined(__GNUC__)
+#define CPPBUGS_CACHE_ALIGNED __attribute__((aligned(64)))
+#elif defined(_MSC_VER)
+#define CPPBUGS_CACHE_ALIGNED __declspec(align(64))
+#else
+#define CPPBUGS_CACHE_ALIGNED
+#endif
+
   /* ICSIlog V 2.0 */
-  const std::vector<float> fill_icsi_log_table2(const unsigned int precision) {
-    std::vector<float> pTable(static_cast<size_t>(pow(2.0,static_cast<double>(precision))));
-
-    /* step along table elements and x-axis positions
-       (start with extra half increment, so the steps intersect at their midpoints.) */
-    float oneToTwo = 1.0f + (1.0f / (float)( 1 <<(precision + 1) ));
-    for(int i = 0;  i < (1 << precision);  ++i ) {
-      // make y-axis value for table element
-      pTable[i] = logf(oneToTwo) / 0.69314718055995f;
-      oneToTwo += 1.0f / (float)( 1 << precision );
+  struct CPPBUGS_CACHE_ALIGNED icsi_log_table {
+    static const unsigned int precision = 10;
+    float v[1 << precision];
+
+    icsi_log_table() {
+      /* step along table elements and x-axis positions
+         (start with extra half increment, so the steps intersect at their midpoints.) */
+      float oneToTwo = 1.0f + (1.0f / (float)( 1 <<(precision + 1) ));
+      for(int i = 0;  i < (1 << precision);  ++i ) {
+        // make y-axis value for table element
+        v[i] = logf(oneToTwo) / 0.69314718055995f;
+        oneToTwo += 1.0f / (float)( 1 << precision );
+      }
     }
-    return pTable;
+  };
+
+  inline const icsi_log_table& get_icsi_log_table() {
+    static const icsi_log_table table;
+    return table;
   }
 
   /* ICSIlog v2.0 */
   inline double icsi_log(const double vald) {
     const float val = static_cast<float>(vald);
-    const unsigned int precision(10);
-    static std::vector<float> pTable = fill_icsi_log_table2(precision);
+    const unsigned int precision(icsi_log_table::precision);
+    const float* const pTable = get_icsi_log_table().v;
 
     /* get access to float bits */
-    register const int* const pVal = (const int*)(&val);
+    boost::int32_t bits;
+    memcpy(&bits, &val, sizeof(bits));
 
     /* extract exponent and mantissa (quantized) */
-    register const int exp = ((*pVal >> 23) & 255) - 127;
-    register const int man = (*pVal & 0x7FFFFF) >> (23 - precision);
+    const int exp = ((bits >> 23) & 255) - 127;
+    const int man = (bits & 0x7FFFFF) >> (23 - precision);
 
     /* exponent plus lookup refinement */
     return static_cast<double>(((float)(exp) + pTable[man]) * 0.69314718055995f);
   }
 
+  // log(i!) for 0 <= i < CPPBUGS_FACTLN_TABLE_SIZE, larger arguments fall back to lgamma
+#ifndef CPPBUGS_FACTLN_TABLE_SIZE
+#define CPPBUGS_FACTLN_TABLE_SIZE 1024
+#endif
+
+  struct CPPBUGS_CACHE_ALIGNED factln_table {
+    static const int size = CPPBUGS_FACTLN_TABLE_SIZE;
+    double v[size];
+
+    factln_table() {
+      for(int j = 0; j < size; j++) {
+        v[j] = j < 2 ? 0 : boost::math::lgamma(static_cast<double>(j) + 1);
+      }
+    }
+  };
+
+  inline const factln_table& get_factln_table() {
+    static const factln_table table;
+    return table;
+  }
+
+  // build every table up front, so neither the first logp() nor a race between
+  // threads pays for it
+  inline void warm_math_tables() {
+    get_icsi_log_table();
+    get_factln_table();
+    kernels();
+  }
+
   inline double log_approx(const double x) {
     return x <= 0 ? -std::numeric_limits<double>::infinity() : icsi_log(x);
   }
@@ -158,24 +212,16 @@ namespace arma {
 namespace arma {
   // factln
 
-  double factln(const int i) {
-    static std::vector<double> factln_table;
-
+  inline double factln(const int i) {
     if(i < 0) {
       return -std::numeric_limits<double>::infinity();
     }
 
-    if(i > 100) {
+    if(i >= cppbugs::factln_table::size) {
       return boost::math::lgamma(static_cast<double>(i) + 1);
     }
 
-    if(factln_table.size() < static_cast<size_t>(i+1)) {
-      for(int j = factln_table.size(); j < (i+1); j++) {
-        factln_table.push_back(std::log(boost::math::factorial<double>(static_cast<double>(j))));
-      }
-    }
-    //for(auto v : factln_table) { std::cout << v << "|"; }  std::cout << std::endl;
-    return factln_table[i];
+    return cppbugs::get_factln_table().v[i];
   }
 
   class eop_factln : public eop_core<eop_factln> {};
@@ -315,48 +361,450 @@ namespace cppbugs {
     return arma::as_scalar(err * sigma.i() * err.t());
   }
 
-  template<typename T, typename U, typename V>
-  double normal_logp(const T& x, const U& mu, const V& tau) {
-    return arma::accu(0.5*log_approx(0.5*tau/arma::math::pi()) - 0.5 * arma::schur(tau, square(x - mu)));
+  // math policies for the *_logp functions
+  // each provides log, log1p, exp, log_sigmoid and lgamma; the plain *_logp
+  // functions use default_math, pass a policy explicitly (normal_logp<exact_math>(...))
+  // or define CPPBUGS_MATH_POLICY before including cppbugs to choose per model
+  //
+  // error bounds (max over the stated domain, measured against long double):
+  //   exact_math  libm/boost, within a few ulp everywhere
+  //   table_math  log/log1p: float ICSI table, abs error < 5e-4 (x normal, x > 0)
+  //               exp/lgamma as exact_math; the historical cppbugs behaviour
+  //   poly_math   log/log1p: rel error < 1e-15 (x > 0 incl. subnormals, x > -1)
+  //               exp: rel error < 1e-15 (|x| < 708)
+  //               lgamma: abs error < 1e-12 (0 < x < 100), rel error < 1e-15 above
+  //               log_sigmoid: abs error < 1e-14
+  //               branch free and written against doubles only, so the loops
+  //               in the *_logp functions vectorise
+  // log is -inf for x <= 0 in table_math and poly_math, so a non-positive
+  // precision or probability still rejects the proposal; poly_math passes nan
+  // and +inf through like libm (checked by test/math.policy.test.cpp)
+
+  struct exact_math {
+    static double log(const double x) { return std::log(x); }
+    static double log1p(const double x) { return boost::math::log1p(x); }
+    static double exp(const double x) { return std::exp(x); }
+    static double log_sigmoid(const double x) { return -(std::max(-x, 0.0) + boost::math::log1p(std::exp(-std::abs(x)))); }
+    static double lgamma(const double x) { return boost::math::lgamma(x); }
+  };
+
+  struct table_math {
+    static double log(const double x) { return log_approx(x); }
+    static double log1p(const double x) { return log_approx(1.0 + x); }
+    static double exp(const double x) { return std::exp(x); }
+    static double log_sigmoid(const double x) { return -log_approx(1.0 + std::exp(-x)); }
+    static double lgamma(const double x) { return boost::math::lgamma(x); }
+  };
+
+  struct poly_math {
+    static double from_bits(const boost::uint64_t b) { double x; memcpy(&x, &b, sizeof(x)); return x; }
+    static boost::uint64_t to_bits(const double x) { boost::uint64_t b; memcpy(&b, &x, sizeof(b)); return b; }
+
+    // x = 2^e * m with m in [sqrt(1/2), sqrt(2)), log(m) = 2 atanh(s) with s = (m-1)/(m+1), |s| < 0.172
+    static double log(const double x) {
+      const double ln2 = 0.693147180559945309417;
+      const bool tiny = x < 2.2250738585072014e-308;
+      const double xs = tiny ? x * 18014398509481984.0 : x;  // 2^54 lifts subnormals
+      const boost::uint64_t bits = to_bits(xs);
+      int e = static_cast<int>((bits >> 52) & 0x7ff) - 1023;
+      double m = from_bits((bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL);
+      const bool big = m > 1.4142135623730951;
+      m = big ? 0.5 * m : m;
+      e += big ? 1 : 0;
+      const double s = (m - 1.0) / (m + 1.0);
+      const double s2 = s * s;
+      const double p = 1.0 + s2*(1.0/3 + s2*(1.0/5 + s2*(1.0/7 + s2*(1.0/9 + s2*(1.0/11 + s2*(1.0/13 + s2*(1.0/15 + s2*(1.0/17 + s2*(1.0/19)))))))));
+      const double ans = (e - (tiny ? 54 : 0)) * ln2 + 2.0 * s * p;
+      // nan and +inf pass through, the bit tricks above would turn them into finite values
+      return x != x || x == std::numeric_limits<double>::infinity() ? x : (x > 0 ? ans : -std::numeric_limits<double>::infinity());
+    }
+
+    // exact correction of the rounding in 1 + x
+    static double log1p(const double x) {
+      const double u = 1.0 + x;
+      const double d = u - 1.0;
+      return x != x || x == std::numeric_limits<double>::infinity() || d == 0 ? x : log(u) * (x / d);
+    }
+
+    // x = k ln2 + r, |r| <= ln2/2, exp(r) by a degree 13 Taylor polynomial, 2^k built from bits
+    static double exp(const double x) {
+      const double ln2_hi = 0.693147180369123816490, ln2_lo = 1.90821492927058770002e-10;
+      const double xc = x < -708.0 ? -708.0 : (x > 709.0 ? 709.0 : (x != x ? 0.0 : x));
+      const double k = std::floor(xc * 1.44269504088896340736 + 0.5);
+      const double r = (xc - k * ln2_hi) - k * ln2_lo;
+      const double p = 1.0 + r*(1.0 + r*(1.0/2 + r*(1.0/6 + r*(1.0/24 + r*(1.0/120 + r*(1.0/720 + r*(1.0/5040 + r*(1.0/40320 + r*(1.0/362880 + r*(1.0/3628800 + r*(1.0/39916800 + r*(1.0/479001600 + r*(1.0/6227020800.0)))))))))))));
+      const double ans = p * from_bits(static_cast<boost::uint64_t>(static_cast<int>(k) + 1023) << 52);
+      return x != x ? x : (x < -708.0 ? 0.0 : (x > 709.0 ? std::numeric_limits<double>::infinity() : ans));
+    }
+
+    static double log_sigmoid(const double x) {
+      return -(std::max(-x, 0.0) + log1p(exp(-std::abs(x))));
+    }
+
+    // Stirling series, shifted by eight for small arguments:
+    // lgamma(x) = lgamma(x + 8) - log(x (x+1) ... (x+7))
+    static double lgamma(const double x) {
+      const bool shift = x < 8.0;
+      const double z = shift ? x + 8.0 : x;
+      const double prod = shift ? x*(x+1)*(x+2)*(x+3)*(x+4)*(x+5)*(x+6)*(x+7) : 1.0;
+      const double iz = 1.0 / z, iz2 = iz * iz;
+      const double series = iz*(1.0/12 - iz2*(1.0/360 - iz2*(1.0/1260 - iz2*(1.0/1680 - iz2*(1.0/1188)))));
+      const double ans = (z - 0.5) * log(z) - z + 0.918938533204672741780 + series - log(prod);
+      if(x != x || x == std::numeric_limits<double>::infinity()) { return x; }
+      return x > 0 ? ans : boost::math::lgamma(x);
+    }
+  };
+
+#ifndef CPPBUGS_MATH_POLICY
+#define CPPBUGS_MATH_POLICY table_math
+#endif
+  typedef CPPBUGS_MATH_POLICY default_math;
+
+  // element access for the likelihood kernels below
+  // scalars broadcast, arma objects are indexed (size_check below guarantees
+  // that an arma hyperparameter has as many elements as the variable)
+  inline double elem(const double x, const size_t i) { return x; }
+  inline double elem(const int x, const size_t i) { return x; }
+  template<typename eT>
+  inline double elem(const arma::Mat<eT>& x, const size_t i) { return x[i]; }
+
+  // scalar hyperparameters broadcast, arma ones must match x element for element
+  template<typename T>
+  bool conformable(const T& x, const double hyper) { return true; }
+
+  template<typename T>
+  bool conformable(const T& x, const int hyper) { return true; }
+
+  template<typename T, typename eT>
+  bool conformable(const T& x, const arma::Mat<eT>& hyper) { return dim_size(hyper) == dim_size(x); }
+
+  // checked on every calc(), since deterministic hyperparameters usually only
+  // get their size from the first update()
+  template<typename T, typename U>
+  void size_check(const T& x, const U& hyper1) {
+    if(!conformable(x, hyper1)) {
+      throw std::logic_error("ERROR: dimensions of hyperparmeters do not match the stochastic variable.");
+    }
   }
 
   template<typename T, typename U, typename V>
-  double uniform_logp(const T& x, const U& lower, const V& upper) {
-    return (arma::any(arma::vectorise(x < lower)) || arma::any(arma::vectorise(x > upper))) ? -std::numeric_limits<double>::infinity() : -arma::accu(log_approx(upper - lower));
+  void size_check(const T& x, const U& hyper1, const V& hyper2) {
+    size_check(x, hyper1);
+    size_check(x, hyper2);
+  }
+
+  // log(x!) for counts stored as double: the table for whole numbers, lgamma(x + 1)
+  // for fractional or very large ones rather than truncating them to int
+  inline double factln_elem(const double x) {
+    if(x < 0) { return -std::numeric_limits<double>::infinity(); }
+    if(x < cppbugs::factln_table::size && x == std::floor(x)) { return arma::factln(static_cast<int>(x)); }
+    return boost::math::lgamma(x + 1);
+  }
+
+  // contiguous double storage for the dispatched kernels (mcmc.dispatch.hpp),
+  // NULL for scalars and integer valued arma objects
+  inline const double* dense_ptr(const double x) { return NULL; }
+  inline const double* dense_ptr(const int x) { return NULL; }
+  inline const double* dense_ptr(const arma::Mat<double>& x) { return x.memptr(); }
+  template<typename eT>
+  const double* dense_ptr(const arma::Mat<eT>& x) { return NULL; }
+
+  inline bool is_scalar(const double x) { return true; }
+  inline bool is_scalar(const int x) { return true; }
+  template<typename eT>
+  bool is_scalar(const arma::Mat<eT>& x) { return false; }
+
+  // hyperparameter-only terms of one likelihood (lgamma(alpha), log(tau), ...)
+  // element i keeps the hyperparameters its term was computed from and the
+  // term is only recomputed when they change; scalar hyperparameters never
+  // come here, their term is computed once per call and multiplied by n
+  // blocks of a likelihood touch disjoint elements, so blocks may run on
+  // different threads, but prepare() must have been called before them (from
+  // Likelihiood::prepare, so that calc() and terms() never resize it)
+  class HyperTermCache {
+  private:
+    std::vector<double> a_, b_, term_;
+  public:
+    // sizes the cache for n elements, a no-op unless n changed
+    void prepare(const size_t n) {
+      if(term_.size() == n) { return; }
+      a_.assign(n, std::numeric_limits<double>::quiet_NaN());
+      b_.assign(n, std::numeric_limits<double>::quiet_NaN());
+      term_.assign(n, 0);
+    }
+
+    // H::calc(a, b) for element i
+    template<typename H>
+    double get(const size_t i, const double a, const double b) {
+      if(i >= term_.size()) { return H::calc(a, b); }
+      if(a_[i] != a || b_[i] != b) {
+        a_[i] = a;
+        b_[i] = b;
+        term_[i] = H::calc(a, b);
+      }
+      return term_[i];
+    }
+  };
+
+  // the hyperparameter-only parts of the densities below
+  template<typename M>
+  struct normal_hyper_term {
+    static double calc(const double tau, const double) { return 0.5*M::log(0.5*tau/arma::math::pi()); }
+  };
+
+  template<typename M>
+  struct gamma_hyper_term {
+    static double calc(const double alpha, const double beta) { return alpha*M::log(beta) - M::lgamma(alpha); }
+  };
+
+  template<typename M>
+  struct beta_hyper_term {
+    static double calc(const double alpha, const double beta) { return M::lgamma(alpha+beta) - M::lgamma(alpha) - M::lgamma(beta); }
+  };
+
+  template<typename H>
+  double hyper_term(HyperTermCache* cache, const size_t i, const double a, const double b) {
+    return cache ? cache->get<H>(i, a, b) : H::calc(a, b);
+  }
+
+  // the *_logp functions are plain loops so that calc() never builds an
+  // arma temporary (and therefore never touches the heap)
+  // support is checked inside the density loop, so each logp is a single pass
+  // over the data which stops at the first element outside the support
+  // M is one of the math policies above, the overloads without it use default_math
+  // the begin/end overloads sum over elements [begin, end) of x only, so a
+  // large likelihood can be evaluated in blocks (see mcmc.likelihood.reducer.hpp)
+  // terms which depend on scalar hyperparameters only are computed once and
+  // multiplied by the number of elements, elementwise ones are kept in cache
+  // (when the caller has one) until their hyperparameters change
+  // hyper = false leaves those terms out altogether, for callers which know the
+  // hyperparameters are constant and only need logp up to an additive constant
+  template<typename M, typename T, typename U, typename V>
+  double normal_logp(const T& x, const U& mu, const V& tau, const size_t begin, const size_t end, HyperTermCache* cache = NULL, const bool hyper = true) {
+    size_check(x, mu, tau);
+    if(is_scalar(tau)) {
+      const double t = elem(tau,0);
+      const double* xp = dense_ptr(x);
+      const double* mup = dense_ptr(mu);
+      double sq(0);
+      if(xp && mup) {
+        sq = kernels().sum_sq_diff(xp + begin, mup + begin, end - begin);
+      } else {
+        for(size_t i = begin; i < end; i++) {
+          const double err = elem(x,i) - elem(mu,i);
+          sq += err * err;
+        }
+      }
+      return (hyper ? (end - begin) * normal_hyper_term<M>::calc(t, 0) : 0) - 0.5 * t * sq;
+    }
+    double ans(0);
+    for(size_t i = begin; i < end; i++) {
+      const double t = elem(tau,i);
+      const double err = elem(x,i) - elem(mu,i);
+      ans += (hyper ? hyper_term<normal_hyper_term<M> >(cache, i, t, 0) : 0) - 0.5 * t * err * err;
+    }
+    return ans;
+  }
+
+  // support semantics: log(upper - lower) is charged once per element of x,
+  // also for scalar bounds (the arma expression used to charge it once in total)
+  template<typename M, typename T, typename U, typename V>
+  double uniform_logp(const T& x, const U& lower, const V& upper, const size_t begin, const size_t end, const bool hyper = true) {
+    size_check(x, lower, upper);
+    double ans(0);
+    for(size_t i = begin; i < end; i++) {
+      if(elem(x,i) < elem(lower,i) || elem(x,i) > elem(upper,i)) { return -std::numeric_limits<double>::infinity(); }
+      if(hyper) { ans -= M::log(elem(upper,i) - elem(lower,i)); }
+    }
+    return ans;
+  }
+
+  // support semantics: non-positive alpha or beta give -inf (the arma
+  // expression only checked x)
+  template<typename M, typename T, typename U, typename V>
+  double gamma_logp(const T& x, const U& alpha, const V& beta, const size_t begin, const size_t end, HyperTermCache* cache = NULL, const bool hyper = true) {
+    size_check(x, alpha, beta);
+    const bool scalar = is_scalar(alpha) && is_scalar(beta);
+    double ans(0);
+    for(size_t i = begin; i < end; i++) {
+      if(elem(x,i) < 0 || elem(alpha,i) <= 0 || elem(beta,i) <= 0) { return -std::numeric_limits<double>::infinity(); }
+      const double a = elem(alpha,i), b = elem(beta,i), xi = elem(x,i);
+      ans += (a - 1.0)*M::log(xi) - b*xi;
+      if(hyper && !scalar) { ans += hyper_term<gamma_hyper_term<M> >(cache, i, a, b); }
+    }
+    if(hyper && scalar && end > begin) { ans += (end - begin) * gamma_hyper_term<M>::calc(elem(alpha,0), elem(beta,0)); }
+    return ans;
+  }
+
+  template<typename M, typename T, typename U, typename V>
+  double beta_logp(const T& x, const U& alpha, const V& beta, const size_t begin, const size_t end, HyperTermCache* cache = NULL, const bool hyper = true) {
+    size_check(x, alpha, beta);
+    const bool scalar = is_scalar(alpha) && is_scalar(beta);
+    double ans(0);
+    for(size_t i = begin; i < end; i++) {
+      if(elem(x,i) <= 0 || elem(x,i) >= 1 || elem(alpha,i) <= 0 || elem(beta,i) <= 0) { return -std::numeric_limits<double>::infinity(); }
+      const double a = elem(alpha,i), b = elem(beta,i), xi = elem(x,i);
+      ans += (a-1.0)*M::log(xi) + (b-1.0)*M::log1p(-xi);
+      if(hyper && !scalar) { ans += hyper_term<beta_hyper_term<M> >(cache, i, a, b); }
+    }
+    if(hyper && scalar && end > begin) { ans += (end - begin) * beta_hyper_term<M>::calc(elem(alpha,0), elem(beta,0)); }
+    return ans;
+  }
+
+  template<typename M, typename T, typename U, typename V>
+  double binom_logp(const T& x, const U& n, const V& p, const size_t begin, const size_t end, const bool hyper = true) {
+    size_check(x, n, p);
+    double ans(0);
+    for(size_t i = begin; i < end; i++) {
+      if(elem(p,i) <= 0 || elem(p,i) >= 1 || elem(x,i) < 0 || elem(x,i) > elem(n,i)) { return -std::numeric_limits<double>::infinity(); }
+      const double xi = elem(x,i), ni = elem(n,i), pr = elem(p,i);
+      ans += hyper ? xi*M::log(pr) + (ni-xi)*M::log1p(-pr) + factln_elem(ni) - factln_elem(xi) - factln_elem(ni-xi) : xi*M::log(pr) + (ni-xi)*M::log1p(-pr);
+    }
+    return ans;
   }
 
-  template<typename T, typename U, typename V>
-  double gamma_logp(const T& x, const U& alpha, const V& beta) {
-    return arma::any(arma::vectorise(x < 0)) ?
-      -std::numeric_limits<double>::infinity() :
-      arma::accu(arma::schur((alpha - 1.0),log_approx(x)) - arma::schur(beta,x) - lgamma(alpha) + arma::schur(alpha,log_approx(beta)));
+  template<typename M, typename T, typename U>
+  double bernoulli_logp(const T& x, const U& p, const size_t begin, const size_t end) {
+    size_check(x, p);
+    double ans(0);
+    for(size_t i = begin; i < end; i++) {
+      if(elem(p,i) <= 0 || elem(p,i) >= 1 || elem(x,i) < 0 || elem(x,i) > 1) { return -std::numeric_limits<double>::infinity(); }
+      const double xi = elem(x,i), pr = elem(p,i);
+      ans += xi*M::log(pr) + (1-xi)*M::log1p(-pr);
+    }
+    return ans;
   }
 
-  template<typename T, typename U, typename V>
-  double beta_logp(const T& x, const U& alpha, const V& beta) {
-    const double one = 1.0;
-    return arma::any(arma::vectorise(x <= 0)) || arma::any(arma::vectorise(x >= 1)) || arma::any(arma::vectorise(alpha <= 0)) || arma::any(arma::vectorise(beta <= 0)) ?
-      -std::numeric_limits<double>::infinity() :
-      arma::accu(lgamma(alpha+beta) - lgamma(alpha) - lgamma(beta) + arma::schur((alpha-one),log_approx(x)) + arma::schur((beta-one),log_approx(one-x)));
+  template<typename M, typename T, typename U>
+  double exponential_logp(const T& x, const U& lambda, const size_t begin, const size_t end) {
+    size_check(x, lambda);
+    double ans(0);
+    for(size_t i = begin; i < end; i++) {
+      const double l = elem(lambda,i);
+      ans += M::log(l) - l*elem(x,i);
+    }
+    return ans;
   }
 
-  template<typename T, typename U, typename V>
-  double binom_logp(const T& x, const U& n, const V& p) {
-    if(arma::any(arma::vectorise(p <= 0)) || arma::any(arma::vectorise(p >= 1)) || arma::any(arma::vectorise(x < 0))  || arma::any(arma::vectorise(x > n))) {
-      return -std::numeric_limits<double>::infinity();
+  template<typename M, typename T, typename U, typename V>
+  double exponential_censored_logp(const T& x, const U& lambda, const V& delta, const size_t begin, const size_t end) {
+    size_check(x, lambda, delta);
+    double ans(0);
+    for(size_t i = begin; i < end; i++) {
+      const double l = elem(lambda,i);
+      ans += elem(delta,i)*M::log(l) - l*elem(x,i);
     }
-    return arma::accu(arma::schur(x,log_approx(p)) + arma::schur((n-x),log_approx(1-p)) + arma::factln(n) - arma::factln(x) - arma::factln(n-x));
+    return ans;
   }
 
-  template<typename T, typename U>
-  double bernoulli_logp(const T& x, const U& p) {
-    if( arma::any(arma::vectorise(p <= 0)) || arma::any(arma::vectorise(p >= 1)) || arma::any(arma::vectorise(x < 0))  || arma::any(arma::vectorise(x > 1)) ) {
-      return -std::numeric_limits<double>::infinity();
-    } else {
-      return arma::accu(arma::schur(x,log_approx(p)) + arma::schur((1-x), log_approx(1-p)));
+  // kernels for observed data: x never changes, so its transforms (log x,
+  // log(1-x), the binomial coefficient) are computed once when the likelihood
+  // is built and x is known to lie in the support; what is left per element
+  // is a couple of multiply-adds against the hyperparameters
+  template<typename T>
+  void observed_values(const T& x, std::vector<double>& out) {
+    out.resize(static_cast<size_t>(dim_size(x)));
+    for(size_t i = 0; i < out.size(); i++) { out[i] = elem(x,i); }
+  }
+
+  struct binom_coef_term {
+    static double calc(const double n, const double x) { return factln_elem(n) - factln_elem(x) - factln_elem(n-x); }
+  };
+
+  template<typename M, typename T, typename U, typename V>
+  double gamma_logp_observed(const T& x, const double* xd, const double* log_x, const U& alpha, const V& beta, const size_t begin, const size_t end, HyperTermCache* cache, const bool hyper = true) {
+    size_check(x, alpha, beta);
+    const bool scalar = is_scalar(alpha) && is_scalar(beta);
+    double ans(0);
+    for(size_t i = begin; i < end; i++) {
+      const double a = elem(alpha,i), b = elem(beta,i);
+      if(a <= 0 || b <= 0) { return -std::numeric_limits<double>::infinity(); }
+      ans += (a - 1.0)*log_x[i] - b*xd[i];
+      if(hyper && !scalar) { ans += hyper_term<gamma_hyper_term<M> >(cache, i, a, b); }
+    }
+    if(hyper && scalar && end > begin) { ans += (end - begin) * gamma_hyper_term<M>::calc(elem(alpha,0), elem(beta,0)); }
+    return ans;
+  }
+
+  template<typename M, typename T, typename U, typename V>
+  double beta_logp_observed(const T& x, const double* log_x, const double* log_1mx, const U& alpha, const V& beta, const size_t begin, const size_t end, HyperTermCache* cache, const bool hyper = true) {
+    size_check(x, alpha, beta);
+    const bool scalar = is_scalar(alpha) && is_scalar(beta);
+    double ans(0);
+    for(size_t i = begin; i < end; i++) {
+      const double a = elem(alpha,i), b = elem(beta,i);
+      if(a <= 0 || b <= 0) { return -std::numeric_limits<double>::infinity(); }
+      ans += (a-1.0)*log_x[i] + (b-1.0)*log_1mx[i];
+      if(hyper && !scalar) { ans += hyper_term<beta_hyper_term<M> >(cache, i, a, b); }
     }
+    if(hyper && scalar && end > begin) { ans += (end - begin) * beta_hyper_term<M>::calc(elem(alpha,0), elem(beta,0)); }
+    return ans;
+  }
+
+  // the coefficient is cached against n, so a constant n costs one comparison per element
+  template<typename M, typename T, typename U, typename V>
+  double binom_logp_observed(const T& x, const double* xd, const U& n, const V& p, const size_t begin, const size_t end, HyperTermCache* cache, const bool hyper = true) {
+    size_check(x, n, p);
+    const bool scalar_p = is_scalar(p);
+    const double log_p = scalar_p ? M::log(elem(p,0)) : 0, log_1mp = scalar_p ? M::log1p(-elem(p,0)) : 0;
+    double ans(0);
+    for(size_t i = begin; i < end; i++) {
+      const double ni = elem(n,i), pr = elem(p,i);
+      if(pr <= 0 || pr >= 1 || xd[i] > ni) { return -std::numeric_limits<double>::infinity(); }
+      const double lp = scalar_p ? log_p : M::log(pr), l1p = scalar_p ? log_1mp : M::log1p(-pr);
+      ans += xd[i]*lp + (ni-xd[i])*l1p + (hyper ? hyper_term<binom_coef_term>(cache, i, ni, xd[i]) : 0);
+    }
+    return ans;
   }
 
+  template<typename M, typename T, typename U, typename V>
+  double normal_logp(const T& x, const U& mu, const V& tau) { return normal_logp<M>(x, mu, tau, 0, static_cast<size_t>(dim_size(x))); }
+
+  template<typename M, typename T, typename U, typename V>
+  double uniform_logp(const T& x, const U& lower, const V& upper) { return uniform_logp<M>(x, lower, upper, 0, static_cast<size_t>(dim_size(x))); }
+
+  template<typename M, typename T, typename U, typename V>
+  double gamma_logp(const T& x, const U& alpha, const V& beta) { return gamma_logp<M>(x, alpha, beta, 0, static_cast<size_t>(dim_size(x))); }
+
+  template<typename M, typename T, typename U, typename V>
+  double beta_logp(const T& x, const U& alpha, const V& beta) { return beta_logp<M>(x, alpha, beta, 0, static_cast<size_t>(dim_size(x))); }
+
+  template<typename M, typename T, typename U, typename V>
+  double binom_logp(const T& x, const U& n, const V& p) { return binom_logp<M>(x, n, p, 0, static_cast<size_t>(dim_size(x))); }
+
+  template<typename M, typename T, typename U>
+  double bernoulli_logp(const T& x, const U& p) { return bernoulli_logp<M>(x, p, 0, static_cast<size_t>(dim_size(x))); }
+
+  template<typename M, typename T, typename U>
+  double exponential_logp(const T& x, const U& lambda) { return exponential_logp<M>(x, lambda, 0, static_cast<size_t>(dim_size(x))); }
+
+  template<typename M, typename T, typename U, typename V>
+  double exponential_censored_logp(const T& x, const U& lambda, const V& delta) { return exponential_censored_logp<M>(x, lambda, delta, 0, static_cast<size_t>(dim_size(x))); }
+
+  template<typename T, typename U, typename V>
+  double normal_logp(const T& x, const U& mu, const V& tau) { return normal_logp<default_math>(x, mu, tau); }
+
+  template<typename T, typename U, typename V>
+  double uniform_logp(const T& x, const U& lower, const V& upper) { return uniform_logp<default_math>(x, lower, upper); }
+
+  template<typename T, typename U, typename V>
+  double gamma_logp(const T& x, const U& alpha, const V& beta) { return gamma_logp<default_math>(x, alpha, beta); }
+
+  template<typename T, typename U, typename V>
+  double beta_logp(const T& x, const U& alpha, const V& beta) { return beta_logp<default_math>(x, alpha, beta); }
+
+  template<typename T, typename U, typename V>
+  double binom_logp(const T& x, const U& n, const V& p) { return binom_logp<default_math>(x, n, p); }
+
+  template<typename T, typename U>
+  double bernoulli_logp(const T& x, const U& p) { return bernoulli_logp<default_math>(x, p); }
+
+  template<typename T, typename U>
+  double exponential_logp(const T& x, const U& lambda) { return exponential_logp<default_math>(x, lambda); }
+
+  template<typename T, typename U, typename V>
+  double exponential_censored_logp(const T& x, const U& lambda, const V& delta) { return exponential_censored_logp<default_math>(x, lambda, delta); }
+
   // sigma denotes cov matrix rather than precision matrix
   double multivariate_normal_sigma_logp(const arma::rowvec& x, const arma::rowvec& mu, const arma::mat& sigma) {
     const double log_2pi = log(2 * arma::math::pi());
@@ -381,6 +829,30 @@ namespace cppbugs {
     return -arma::accu(x.n_elem * log_2pi + log_approx(arma::det(sigma)) + mahalanobis(x,mu,sigma))/2;
   }
 
+  // same as above, but R (upper cholesky factor) and z are preallocated
+  // sigma.n_rows x sigma.n_cols and x.n_elem scratch space owned by the caller
+  template<typename T, typename U>
+  double multivariate_normal_sigma_logp(const T& x, const U& mu, const arma::mat& sigma, arma::mat& R, arma::vec& z) {
+    const double log_2pi = log(2 * arma::math::pi());
+    const arma::uword k = x.n_elem;
+
+    // non-positive definite test via chol
+    if(chol(R,sigma) == false) { return -std::numeric_limits<double>::infinity(); }
+
+    // solve R' z = (x - mu) by forward substitution, mahalanobis distance is z'z
+    double log_det(0), mahal(0);
+    for(arma::uword i = 0; i < k; i++) {
+      double zi = elem(x,i) - elem(mu,i);
+      for(arma::uword j = 0; j < i; j++) {
+        zi -= R(j,i) * z[j];
+      }
+      z[i] = zi / R(i,i);
+      mahal += z[i] * z[i];
+      log_det += 2.0 * log_approx(R(i,i));
+    }
+    return -(k * log_2pi + log_det + mahal)/2;
+  }
+
   template<typename T, typename U, typename V>
   void dimension_check(const T& x, const U& hyper1, const V& hyper2) {
     if(dim_size(hyper1) > dim_size(x) || dim_size(hyper2) > dim_size(x)) {
@@ -0,0 +1,192 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_MODEL_GRAPH_HPP
+#define MCMC_MODEL_GRAPH_HPP
+
+#include <cstddef>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <algorithm>
+#if __cplusplus >= 201103L
+#include <chrono>
+#endif
+#include <cppbugs/mcmc.object.hpp>
+#include <cppbugs/mcmc.stochastic.hpp>
+
+namespace cppbugs {
+
+  // seconds on a monotonic clock (processor time before C++11)
+  inline double profile_clock() {
+#if __cplusplus >= 201103L
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+  }
+
+  // time spent in one node while sampling: jumps (for deterministic nodes the
+  // recomputation of their value) and evaluations of its likelihood
+  struct NodeProfile {
+    double jump_time, calc_time;
+    size_t jumps, calcs;
+    NodeProfile(): jump_time(0), calc_time(0), jumps(0), calcs(0) {}
+    double total() const { return jump_time + calc_time; }
+  };
+
+  // the model as a DAG, an edge for every value a node reads from another
+  // node, each node annotated with its size and profile
+  class ModelGraph {
+  public:
+    struct Node {
+      std::string name, kind;
+      double size;
+      NodeProfile profile;
+    };
+  private:
+    std::vector<Node> nodes_;
+    std::vector<std::pair<size_t, size_t> > edges_;
+    size_t iterations_;
+
+    double total_time() const {
+      double ans(0);
+      for(size_t i = 0; i < nodes_.size(); i++) { ans += nodes_[i].profile.total(); }
+      return ans;
+    }
+    static double mean(const double t, const size_t n) { return n ? t / n : 0; }
+    double per_iteration(const size_t n) const { return iterations_ ? static_cast<double>(n) / iterations_ : 0; }
+    double share(const Node& node, const double total) const { return total > 0 ? node.profile.total() / total : 0; }
+
+    static std::string escape(const std::string& s) {
+      std::string ans;
+      for(size_t i = 0; i < s.size(); i++) {
+        if(s[i] == '"' || s[i] == '\\') { ans += '\\'; }
+        ans += s[i];
+      }
+      return ans;
+    }
+  public:
+    ModelGraph(): iterations_(0) {}
+
+    size_t addNode(const std::string& name, const std::string& kind, const double size, const NodeProfile& profile) {
+      Node node;
+      node.name = name;
+      node.kind = kind;
+      node.size = size;
+      node.profile = profile;
+      nodes_.push_back(node);
+      return nodes_.size() - 1;
+    }
+
+    void addEdge(const size_t from, const size_t to) {
+      const std::pair<size_t, size_t> edge(from, to);
+      if(from != to && std::find(edges_.begin(), edges_.end(), edge) == edges_.end()) { edges_.push_back(edge); }
+    }
+
+    // sweeps the profile covers (steps plus tuning sweeps)
+    void setIterations(const size_t iterations) { iterations_ = iterations; }
+
+    const std::vector<Node>& nodes() const { return nodes_; }
+    const std::vector<std::pair<size_t, size_t> >& edges() const { return edges_; }
+
+    // graphviz: stochastic nodes are ellipses, deterministic ones boxes and
+    // observed ones double ellipses, filled redder the larger their share of the time
+    void writeDot(std::ostream& os) const {
+      const double total = total_time();
+      os << "digraph model {\n";
+      for(size_t i = 0; i < nodes_.size(); i++) {
+        const Node& n = nodes_[i];
+        const NodeProfile& p = n.profile;
+        os << "  n" << i << " [label=\"" << escape(n.name) << "\\n" << n.kind << ", " << n.size << " elements";
+        if(p.jumps) { os << "\\njump " << mean(p.jump_time, p.jumps) * 1e6 << " us x " << per_iteration(p.jumps) << "/iter"; }
+        if(p.calcs) { os << "\\ncalc " << mean(p.calc_time, p.calcs) * 1e6 << " us x " << per_iteration(p.calcs) << "/iter"; }
+        if(total > 0) { os << "\\n" << share(n, total) * 100 << "% of time"; }
+        os << "\", shape=" << (n.kind == "deterministic" ? "box" : "ellipse");
+        if(n.kind == "observed") { os << ", peripheries=2"; }
+        os << ", style=filled, fillcolor=\"0.0 " << share(n, total) << " 1.0\"];\n";
+      }
+      for(size_t i = 0; i < edges_.size(); i++) {
+        os << "  n" << edges_[i].first << " -> n" << edges_[i].second << ";\n";
+      }
+      os << "}\n";
+    }
+
+    // times are mean seconds per jump / calc
+    void writeJson(std::ostream& os) const {
+      const double total = total_time();
+      os << "{\"iterations\": " << iterations_ << ", \"nodes\": [";
+      for(size_t i = 0; i < nodes_.size(); i++) {
+        const Node& n = nodes_[i];
+        const NodeProfile& p = n.profile;
+        os << (i ? ", " : "") << "{\"id\": " << i << ", \"name\": \"" << escape(n.name) << "\", \"kind\": \"" << n.kind << "\", \"size\": " << n.size
+           << ", \"jumps\": " << p.jumps << ", \"jump_time\": " << mean(p.jump_time, p.jumps) << ", \"jumps_per_iteration\": " << per_iteration(p.jumps)
+           << ", \"calcs\": " << p.calcs << ", \"calc_time\": " << mean(p.calc_time, p.calcs) << ", \"calcs_per_iteration\": " << per_iteration(p.calcs)
+           << ", \"share\": " << share(n, total) << "}";
+      }
+      os << "], \"edges\": [";
+      for(size_t i = 0; i < edges_.size(); i++) {
+        os << (i ? ", " : "") << "[" << edges_[i].first << ", " << edges_[i].second << "]";
+      }
+      os << "]}\n";
+    }
+  };
+
+  inline const char* node_kind(const MCMCObject& node) {
+    return node.isObserved() ? "observed" : (node.isDeterministc() ? "deterministic" : "stochastic");
+  }
+
+  // one graph node per model node (names[i], "node i" where missing); an edge
+  // into a stochastic node from every node its likelihood reads and into a
+  // deterministic node from every node it reports as an input
+  inline ModelGraph build_model_graph(const std::vector<MCMCObject*>& nodes, const std::vector<std::string>& names, const std::vector<NodeProfile>& profiles, const size_t iterations) {
+    ModelGraph ans;
+    std::map<const void*, size_t> index;
+    for(size_t i = 0; i < nodes.size(); i++) {
+      std::string name = i < names.size() ? names[i] : std::string();
+      if(name.empty()) {
+        std::ostringstream ss;
+        ss << "node " << i;
+        name = ss.str();
+      }
+      // observed nodes report no size of their own, their likelihood knows how much data there is
+      double size = nodes[i]->size();
+      const Stochastic* sp = dynamic_cast<const Stochastic*>(nodes[i]);
+      if(sp && sp->getLikelihoodFunctor()) { size = std::max(size, static_cast<double>(sp->getLikelihoodFunctor()->terms())); }
+      ans.addNode(name, node_kind(*nodes[i]), size, i < profiles.size() ? profiles[i] : NodeProfile());
+      if(nodes[i]->valueAddress()) { index[nodes[i]->valueAddress()] = i; }
+    }
+    std::vector<const void*> in;
+    for(size_t i = 0; i < nodes.size(); i++) {
+      in.clear();
+      nodes[i]->inputs(in);
+      const Stochastic* sp = dynamic_cast<const Stochastic*>(nodes[i]);
+      if(sp && sp->getLikelihoodFunctor()) { sp->getLikelihoodFunctor()->inputs(in); }
+      for(size_t k = 0; k < in.size(); k++) {
+        std::map<const void*, size_t>::const_iterator from = index.find(in[k]);
+        if(from != index.end()) { ans.addEdge(from->second, i); }
+      }
+    }
+    ans.setIterations(iterations);
+    return ans;
+  }
+
+} // namespace cppbugs
+#endif // MCMC_MODEL_GRAPH_HPP
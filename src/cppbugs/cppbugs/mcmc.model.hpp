@@ -22,11 +22,23 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <set>
+#include <string>
+#include <algorithm>
+#include <memory>
 #include <exception>
 #include <boost/random.hpp>
 #include <cppbugs/mcmc.rng.hpp>
+#include <cppbugs/mcmc.philox.hpp>
 #include <cppbugs/mcmc.object.hpp>
 #include <cppbugs/mcmc.stochastic.hpp>
+#include <cppbugs/mcmc.flat.state.hpp>
+#include <cppbugs/mcmc.arena.hpp>
+#include <cppbugs/mcmc.math.hpp>
+#include <cppbugs/mcmc.thread.pool.hpp>
+#include <cppbugs/mcmc.likelihood.reducer.hpp>
+#include <cppbugs/mcmc.blas.threads.hpp>
+#include <cppbugs/mcmc.model.graph.hpp>
 
 namespace cppbugs {
   typedef std::map<void*,MCMCObject*> vmc_map;
@@ -35,28 +47,343 @@ namespace cppbugs {
   template<class RNG>
   class MCModel {
   private:
+    // owns every node created by track<>() and their likelihood functors
+    Arena arena_;
     double accepted_,rejected_,logp_value_,old_logp_value_;
+    bool flat_;
     SpecializedRng<RNG> rng_;
+    // counter based streams, one per node plus accept/reject and the flat block
+    // only used once seed() has been called, otherwise everything draws from rng_
+    bool seeded_;
+    boost::uint64_t seed_;
+    boost::uint32_t chain_;
+    std::vector<PhiloxRng> streams_;
+    std::vector<RngBase*> jumping_rngs, loose_jumping_rngs;
+    RngBase* accept_rng_;
+    RngBase* flat_rng_;
     std::vector<MCMCObject*> mcmcObjects, jumping_nodes, dynamic_nodes;
+    // nodes step() still has to visit one by one (all of them unless flat_)
+    std::vector<MCMCObject*> loose_jumping_nodes, loose_dynamic_nodes;
     std::vector<Likelihiood*> logp_functors;
+    // unnormalised mode (see setNormalised): likelihoods with no varying input
+    // are moved out of logp_functors into constant_functors, the rest keep the
+    // fixed flags they were given so they can be put back after normalisedLogp()
+    // constants_ holds the addresses declared with setConstant()
+    bool normalised_;
+    std::set<const void*> constants_;
+    std::vector<Likelihiood*> constant_functors;
+    std::vector<std::vector<bool> > functor_fixed_;
+    // large likelihoods are split over pool_ (if setThreads() asked for one)
+    std::unique_ptr<ThreadPool> pool_;
+    LikelihoodReducer reducer_;
+    // blas == 0 leaves the blas thread count alone
+    ThreadSplit split_;
     std::function<void ()> update;
+    // update split into pieces which declare what they read and write (addUpdate),
+    // in dependency order once initChain has run
+    struct DeclaredUpdate {
+      std::function<void ()> f;
+      std::vector<const void*> inputs, outputs;
+    };
+    std::vector<DeclaredUpdate> updates_;
+    // what a jump of jumping_nodes[j] touches: the updates downstream of it, the
+    // tracked values they write (preserved and reverted with the node) and the
+    // likelihoods reading any of those (and the reducer's plan for them);
+    // rerun when some written value is not a tracked node and has to be
+    // recomputed on reject instead
+    struct NodeEffect {
+      std::vector<size_t> updates, functors;
+      LikelihoodPlan plan;
+      std::vector<MCMCObject*> outputs;
+      bool rerun;
+    };
+    // graph_ is set when every update was declared, so tune() can jump a node
+    // and only pay for what depends on it
+    bool graph_;
+    std::vector<NodeEffect> effects_;
+    std::vector<double> functor_values_, saved_values_;
     vmc_map data_node_map;
+    FlatState flat_state_;
+    std::vector<MCMCObject*> flat_nodes_;
+    // setProfile(): timings for modelGraph(), indexed like mcmcObjects, with the
+    // update function (if any) kept on its own; declared updates are charged to
+    // the tracked values they write, a flat block jump to its nodes by size
+    // likelihood times are kept by reducer_ and added in by modelGraph()
+    bool profile_;
+    std::vector<NodeProfile> profiles_;
+    NodeProfile update_profile_;
+    size_t profile_iterations_;
+    std::map<const MCMCObject*, size_t> node_index_;
+    std::map<const Likelihiood*, size_t> functor_owner_;
+    std::vector<std::vector<size_t> > update_owners_;
+    std::map<const void*, std::string> names_;
+
+    void charge_jump(const std::vector<size_t>& owners, const double t) {
+      if(owners.empty()) {
+        update_profile_.jump_time += t;
+        update_profile_.jumps++;
+      }
+      for(size_t i = 0; i < owners.size(); i++) {
+        profiles_[owners[i]].jump_time += t / owners.size();
+        profiles_[owners[i]].jumps++;
+      }
+    }
+
+    void node_jump(MCMCObject* node, RngBase& rng) {
+      if(!profile_) { node->jump(rng); return; }
+      const double t0 = profile_clock();
+      node->jump(rng);
+      NodeProfile& p = profiles_[node_index_[node]];
+      p.jump_time += profile_clock() - t0;
+      p.jumps++;
+    }
 
-    void jump() { for(auto v : jumping_nodes) { v->jump(rng_); } }
-    void preserve() { for(auto v : dynamic_nodes) { v->preserve(); } }
-    void revert() { for(auto v : dynamic_nodes) { v->revert(); } }
+    void jump() {
+      const double t0 = profile_ ? profile_clock() : 0;
+      flat_state_.jump(*flat_rng_);
+      if(profile_ && !flat_nodes_.empty()) {
+        const double t = profile_clock() - t0;
+        for(size_t i = 0; i < flat_nodes_.size(); i++) {
+          NodeProfile& p = profiles_[node_index_[flat_nodes_[i]]];
+          p.jump_time += t * flat_nodes_[i]->size() / flat_state_.size();
+          p.jumps++;
+        }
+      }
+      for(size_t i = 0; i < loose_jumping_nodes.size(); i++) { node_jump(loose_jumping_nodes[i], *loose_jumping_rngs[i]); }
+    }
+
+    void preserve() { flat_state_.preserve(); for(auto v : loose_dynamic_nodes) { v->preserve(); } }
+    void revert() { flat_state_.revert(); for(auto v : loose_dynamic_nodes) { v->revert(); } }
     void set_scale(const double scale) { for(auto v : jumping_nodes) { v->setScale(scale); } }
     void tally() { for(auto v : dynamic_nodes) { v->tally(); } }
     static bool bad_logp(const double value) { return std::isnan(value) || value == -std::numeric_limits<double>::infinity() ? true : false; }
+    static void set_arena(Stochastic* node, Arena* arena) { node->setArena(arena); }
+    static void set_arena(void* node, Arena* arena) {}
+
+    void run_update(const size_t u) {
+      if(!profile_) { updates_[u].f(); return; }
+      const double t0 = profile_clock();
+      updates_[u].f();
+      charge_jump(update_owners_[u], profile_clock() - t0);
+    }
+
+    void run_updates() {
+      if(update) {
+        const double t0 = profile_ ? profile_clock() : 0;
+        update();
+        if(profile_) {
+          update_profile_.jump_time += profile_clock() - t0;
+          update_profile_.jumps++;
+        }
+      }
+      for(size_t i = 0; i < updates_.size(); i++) { run_update(i); }
+    }
+
+    static bool writes(const DeclaredUpdate& u, const void* x) {
+      return std::find(u.outputs.begin(), u.outputs.end(), x) != u.outputs.end();
+    }
+
+    // producers before consumers, declaration order between independent updates
+    void order_updates() {
+      const size_t n = updates_.size();
+      std::vector<DeclaredUpdate> ordered;
+      std::vector<bool> done(n, false);
+      while(ordered.size() < n) {
+        size_t next = n;
+        for(size_t i = 0; i < n && next == n; i++) {
+          if(done[i]) { continue; }
+          bool ready = true;
+          for(size_t k = 0; k < n && ready; k++) {
+            if(k == i || done[k]) { continue; }
+            for(size_t in = 0; in < updates_[i].inputs.size() && ready; in++) {
+              if(writes(updates_[k], updates_[i].inputs[in])) { ready = false; }
+            }
+          }
+          if(ready) { next = i; }
+        }
+        if(next == n) {
+          throw std::logic_error("ERROR: declared updates depend on each other in a cycle.");
+        }
+        done[next] = true;
+        ordered.push_back(updates_[next]);
+      }
+      updates_.swap(ordered);
+    }
+
+    // follows each jumping node's value through the declared updates
+    // likelihoods which do not report their inputs are evaluated after every jump
+    void build_effects() {
+      effects_.clear();
+      graph_ = !update && !updates_.empty();
+      std::map<MCMCObject*, const void*> address;
+      for(vmc_map_iter it = data_node_map.begin(); it != data_node_map.end(); it++) { address[it->second] = it->first; }
+      for(size_t j = 0; graph_ && j < jumping_nodes.size(); j++) {
+        if(address.find(jumping_nodes[j]) == address.end()) { graph_ = false; }
+      }
+      if(!graph_) { return; }
+
+      std::vector<std::vector<const void*> > functor_inputs(logp_functors.size());
+      for(size_t k = 0; k < logp_functors.size(); k++) { logp_functors[k]->inputs(functor_inputs[k]); }
+
+      for(size_t j = 0; j < jumping_nodes.size(); j++) {
+        NodeEffect e;
+        e.rerun = false;
+        std::set<const void*> changed;
+        changed.insert(address[jumping_nodes[j]]);
+        for(size_t u = 0; u < updates_.size(); u++) {
+          bool hit = false;
+          for(size_t in = 0; in < updates_[u].inputs.size() && !hit; in++) { hit = changed.count(updates_[u].inputs[in]) > 0; }
+          if(!hit) { continue; }
+          e.updates.push_back(u);
+          for(size_t out = 0; out < updates_[u].outputs.size(); out++) {
+            const void* x = updates_[u].outputs[out];
+            if(!changed.insert(x).second) { continue; }
+            vmc_map_iter node = data_node_map.find(const_cast<void*>(x));
+            if(node == data_node_map.end()) {
+              e.rerun = true;
+            } else {
+              e.outputs.push_back(node->second);
+            }
+          }
+        }
+        for(size_t k = 0; k < logp_functors.size(); k++) {
+          bool hit = functor_inputs[k].empty();
+          for(size_t in = 0; in < functor_inputs[k].size() && !hit; in++) { hit = changed.count(functor_inputs[k][in]) > 0; }
+          if(hit) { e.functors.push_back(k); }
+        }
+        e.plan = reducer_.plan(logp_functors, e.functors);
+        effects_.push_back(e);
+      }
+      functor_values_.assign(logp_functors.size(), 0);
+      saved_values_.assign(logp_functors.size(), 0);
+    }
+
+    void refresh_functor_values() {
+      if(logp_functors.empty()) { return; }
+      reducer_.evaluate(logp_functors, reducer_.modelPlan(), &functor_values_[0], false);
+    }
+
+    // logp after jumping_nodes[j] alone has jumped; the likelihoods it touches
+    // go through the reducer like a full logp(), cheapest first and stopping
+    // at the first -inf (those left unevaluated are restored by node_revert
+    // along with the rest)
+    double node_logp(const size_t j) {
+      const NodeEffect& e = effects_[j];
+      for(size_t i = 0; i < e.outputs.size(); i++) { e.outputs[i]->preserve(); }
+      for(size_t i = 0; i < e.updates.size(); i++) { run_update(e.updates[i]); }
+      for(size_t i = 0; i < e.functors.size(); i++) { saved_values_[e.functors[i]] = functor_values_[e.functors[i]]; }
+      if(!e.functors.empty()) {
+        const double status = reducer_.evaluate(logp_functors, e.plan, &functor_values_[0]);
+        if(bad_logp(status)) { return status; }
+      }
+      double ans(0);
+      for(size_t k = 0; k < functor_values_.size(); k++) { ans += functor_values_[k]; }
+      return ans;
+    }
+
+    // after the node itself has been reverted
+    void node_revert(const size_t j) {
+      const NodeEffect& e = effects_[j];
+      for(size_t i = 0; i < e.outputs.size(); i++) { e.outputs[i]->revert(); }
+      if(e.rerun) {
+        for(size_t i = 0; i < e.updates.size(); i++) { run_update(e.updates[i]); }
+      }
+      for(size_t i = 0; i < e.functors.size(); i++) { functor_values_[e.functors[i]] = saved_values_[e.functors[i]]; }
+    }
+
+    // an input is constant only if it is the value of an observed node or was
+    // declared with setConstant(); anything else (a sampled node, a value the
+    // update function computes, an address the model never saw) may vary
+    // a declared address which turns out to be sampled or written by an
+    // update is still taken as varying
+    void drop_constants() {
+      constant_functors.clear();
+      functor_fixed_.clear();
+      std::set<const void*> fixed_inputs(constants_);
+      for(vmc_map_iter it = data_node_map.begin(); it != data_node_map.end(); it++) {
+        if(it->second->isObserved()) { fixed_inputs.insert(it->first); }
+      }
+      for(vmc_map_iter it = data_node_map.begin(); it != data_node_map.end(); it++) {
+        if(!it->second->isObserved()) { fixed_inputs.erase(it->first); }
+      }
+      for(size_t i = 0; i < updates_.size(); i++) {
+        for(size_t j = 0; j < updates_[i].outputs.size(); j++) { fixed_inputs.erase(updates_[i].outputs[j]); }
+      }
+
+      std::vector<Likelihiood*> kept;
+      std::vector<const void*> in;
+      for(size_t i = 0; i < logp_functors.size(); i++) {
+        in.clear();
+        logp_functors[i]->inputs(in);
+        std::vector<bool> fixed;
+        bool all_fixed = !normalised_ && !in.empty();
+        if(!normalised_) {
+          for(size_t j = 0; j < in.size(); j++) {
+            fixed.push_back(fixed_inputs.count(in[j]) != 0);
+            all_fixed = all_fixed && fixed.back();
+          }
+        }
+        if(all_fixed) {
+          logp_functors[i]->dropConstants(std::vector<bool>());
+          constant_functors.push_back(logp_functors[i]);
+        } else {
+          logp_functors[i]->dropConstants(fixed);
+          kept.push_back(logp_functors[i]);
+          functor_fixed_.push_back(fixed);
+        }
+      }
+      logp_functors.swap(kept);
+    }
+
+    // also maps likelihoods and declared updates to the nodes they are charged to
+    void init_profile() {
+      profiles_.assign(mcmcObjects.size(), NodeProfile());
+      update_profile_ = NodeProfile();
+      profile_iterations_ = 0;
+      node_index_.clear();
+      functor_owner_.clear();
+      std::map<const void*, size_t> index;
+      for(size_t i = 0; i < mcmcObjects.size(); i++) {
+        node_index_[mcmcObjects[i]] = i;
+        if(mcmcObjects[i]->valueAddress()) { index[mcmcObjects[i]->valueAddress()] = i; }
+        Stochastic* sp = dynamic_cast<Stochastic*>(mcmcObjects[i]);
+        if(sp && sp->getLikelihoodFunctor()) { functor_owner_[sp->getLikelihoodFunctor()] = i; }
+      }
+      update_owners_.assign(updates_.size(), std::vector<size_t>());
+      for(size_t u = 0; u < updates_.size(); u++) {
+        for(size_t out = 0; out < updates_[u].outputs.size(); out++) {
+          std::map<const void*, size_t>::const_iterator owner = index.find(updates_[u].outputs[out]);
+          if(owner != index.end()) { update_owners_[u].push_back(owner->second); }
+        }
+      }
+    }
+
+    template<typename N, typename T>
+    N* create_node(T& x) {
+      N* node = arena_.create<N>(x);
+      set_arena(node, &arena_);
+      mcmcObjects.push_back(node);
+      data_node_map[(void*)(&x)] = node;
+      return node;
+    }
   public:
-    MCModel(std::function<void ()> update_): accepted_(0), rejected_(0), logp_value_(-std::numeric_limits<double>::infinity()), old_logp_value_(-std::numeric_limits<double>::infinity()), update(update_) {}
+    // update_ recomputes every derived value; it may be left empty when the
+    // model is described with addUpdate() instead
+    // update_ may write a tracked deterministic value only in part (y_hat.col(0) = ...,
+    // +=): it always starts from the current value; outputs of addUpdate() are
+    // double buffered instead and must be overwritten in full
+    MCModel(std::function<void ()> update_ = std::function<void ()>()): accepted_(0), rejected_(0), logp_value_(-std::numeric_limits<double>::infinity()), old_logp_value_(-std::numeric_limits<double>::infinity()), flat_(false), seeded_(false), seed_(0), chain_(0), accept_rng_(&rng_), flat_rng_(&rng_), normalised_(true), update(update_), graph_(false), profile_(false), profile_iterations_(0) {
+      split_.chains = 1;
+      split_.likelihood = 1;
+      split_.blas = 0;
+      warm_math_tables();
+    }
     ~MCModel() {
-      // use data_node_map as delete list
-      // only objects allocated by this class are inserted thre
-      // addNode allows user allocated objects to enter the mcmcObjects vector
-      for(auto m : data_node_map) {
-        delete m.second;
-      }
+      // flattened values must get their memory back before the nodes go away
+      flat_state_.release();
+
+      // nodes created by track<>() are destroyed and freed with arena_
+      // track(MCMCObject*) allows user allocated objects to enter the mcmcObjects vector
     }
 
     void addStochcasticNode(MCMCObject* node) {
@@ -65,23 +392,217 @@ namespace cppbugs {
       if(sp && sp->getLikelihoodFunctor() ) { logp_functors.push_back(sp->getLikelihoodFunctor()); }
     }
 
+    // pack all flattenable parameters into one contiguous state vector
+    // must be set before sample() is called
+    void setFlatState(const bool flat) {
+      flat_ = flat;
+    }
+
+    // time every jump, update and likelihood evaluation for modelGraph()
+    // likelihoods are timed by the reducer, so they keep their order, threads
+    // and short-circuit while being profiled
+    // must be set before sample() is called
+    void setProfile(const bool profile) {
+      profile_ = profile;
+    }
+
+    // label for x in modelGraph()
+    template<typename T>
+    void setName(const T& x, const std::string& name) {
+      names_[static_cast<const void*>(&x)] = name;
+    }
+
+    // the model as a DAG annotated with the profile of the last sample()
+    // (see mcmc.model.graph.hpp); the update function (and any declared update
+    // without a tracked output) shows up as a node of its own reading every
+    // stochastic node and writing every deterministic one
+    ModelGraph modelGraph() const {
+      std::vector<std::string> names(mcmcObjects.size());
+      for(size_t i = 0; i < mcmcObjects.size(); i++) {
+        std::map<const void*, std::string>::const_iterator name = names_.find(mcmcObjects[i]->valueAddress());
+        if(name != names_.end()) { names[i] = name->second; }
+      }
+      std::vector<NodeProfile> profiles(profiles_);
+      for(size_t k = 0; k < logp_functors.size(); k++) {
+        NodeProfile& p = profiles[functor_owner_.find(logp_functors[k])->second];
+        p.calc_time += reducer_.time(k);
+        p.calcs += reducer_.count(k);
+      }
+      ModelGraph ans = build_model_graph(mcmcObjects, names, profiles, profile_iterations_);
+
+      std::map<const void*, size_t> index;
+      for(size_t i = 0; i < mcmcObjects.size(); i++) {
+        if(mcmcObjects[i]->valueAddress()) { index[mcmcObjects[i]->valueAddress()] = i; }
+      }
+      for(size_t u = 0; u < updates_.size(); u++) {
+        for(size_t in = 0; in < updates_[u].inputs.size(); in++) {
+          for(size_t out = 0; out < updates_[u].outputs.size(); out++) {
+            std::map<const void*, size_t>::const_iterator from = index.find(updates_[u].inputs[in]), to = index.find(updates_[u].outputs[out]);
+            if(from != index.end() && to != index.end()) { ans.addEdge(from->second, to->second); }
+          }
+        }
+      }
+      if(update || update_profile_.jumps) {
+        const size_t k = ans.addNode("update", "deterministic", 0, update_profile_);
+        for(size_t i = 0; i < mcmcObjects.size(); i++) {
+          if(mcmcObjects[i]->isDeterministc()) { ans.addEdge(k, i); }
+          else if(!mcmcObjects[i]->isObserved()) { ans.addEdge(i, k); }
+        }
+      }
+      return ans;
+    }
+
+    // declares one piece of the update: f recomputes outputs from inputs, both
+    // given as addresses of the model's variables, e.g.
+    //   m.addUpdate([&]() { y_hat = X * b; }, {&b}, {&y_hat});
+    // when there is no update function, tune() reruns only the updates
+    // downstream of the node it jumped and evaluates only the likelihoods
+    // reading what they wrote; derived values should be tracked (Deterministic)
+    // so they can be reverted, untracked ones are recomputed on reject
+    // each update must overwrite its outputs completely: tracked outputs swap
+    // buffers on preserve, so what an update does not write is stale
+    void addUpdate(std::function<void ()> f, const std::vector<const void*>& inputs, const std::vector<const void*>& outputs) {
+      DeclaredUpdate u;
+      u.f = f;
+      u.inputs = inputs;
+      u.outputs = outputs;
+      updates_.push_back(u);
+    }
+
+    // false samples with logp() correct up to an additive constant only: every
+    // likelihood skips the terms which depend on constant inputs alone and
+    // likelihoods without any varying input are not evaluated at all; the
+    // draws are the same in distribution
+    // constant inputs are the values of observed nodes and whatever was
+    // declared with setConstant() (hyperparameters held in variables, data
+    // which is not tracked); every other input is taken as varying, so an
+    // undeclared constant only costs speed, never correctness
+    // normalisedLogp() gives the full value either way
+    // must be set before sample() is called
+    void setNormalised(const bool normalised) {
+      normalised_ = normalised;
+    }
+
+    // declares that x does not change while sampling, e.g.
+    //   const double zero(0), prior_tau(0.001);
+    //   m.setConstant(zero); m.setConstant(prior_tau);
+    //   m.track<Normal>(b).dnorm(zero, prior_tau);
+    // only used by setNormalised(false); x must not be anything the update
+    // function writes (declared sampled nodes and update outputs are ignored)
+    template<typename T>
+    void setConstant(const T& x) {
+      constants_.insert(&x);
+    }
+
+    bool normalised() const { return normalised_; }
+
+    // threads (including the caller's) used to evaluate large likelihoods,
+    // 0 for one per core; workers come out of the process wide ThreadBudget,
+    // so models sampling side by side share the machine rather than oversubscribe
+    // (the driver registers its chain threads with SamplingThreads first)
+    // results do not depend on the number of threads
+    void setThreads(const size_t n) {
+      reducer_.setPool(NULL);
+      pool_.reset();
+      const size_t wanted = n ? n : ThreadBudget::hardware();
+      if(wanted > 1) {
+        pool_.reset(new ThreadPool(wanted));
+        reducer_.setPool(pool_.get());
+      }
+    }
+
+    size_t threads() const { return pool_ ? pool_->size() : 1; }
+
+    // cores for this chain when several run side by side (see split_threads)
+    // a blas with a per thread setting (mkl) gets split.blas from the thread
+    // which calls sample(); for a process wide one (openblas, blis) the driver
+    // calls set_blas_threads(split.blas) once before starting the chains
+    void setThreadSplit(const ThreadSplit& split) {
+      split_ = split;
+      setThreads(split.likelihood);
+    }
+
+    // the split this chain actually ran with: fewer likelihood threads if the
+    // budget ran short, blas as reported by the blas itself (-1 if unknown)
+    ThreadSplit threadSplit() const {
+      ThreadSplit ans = split_;
+      ans.likelihood = threads();
+      ans.blas = blas_threads();
+      return ans;
+    }
+
+    // switch to reproducible counter based streams keyed by (seed, chain, node)
+    // node ids are positions in model order, so a chain replays bit for bit
+    // no matter how many other chains run beside it
+    // must be called before sample()
+    void seed(const boost::uint64_t seed, const boost::uint32_t chain = 0) {
+      seeded_ = true;
+      seed_ = seed;
+      chain_ = chain;
+    }
+
     void initChain() {
       logp_functors.clear();
       jumping_nodes.clear();
+      dynamic_nodes.clear();
+      loose_jumping_nodes.clear();
+      loose_dynamic_nodes.clear();
+      jumping_rngs.clear();
+      loose_jumping_rngs.clear();
+      flat_nodes_.clear();
+
+      // ids 0..n-1 are the nodes, the last two are reserved for accept/reject and the flat block
+      const size_t n = mcmcObjects.size();
+      streams_.clear();
+      if(seeded_) {
+        for(size_t i = 0; i < n + 2; i++) {
+          streams_.push_back(PhiloxRng(seed_, chain_, i < n ? static_cast<boost::uint32_t>(i) : 0xFFFFFFFFu - static_cast<boost::uint32_t>(i - n)));
+        }
+      }
+      accept_rng_ = seeded_ ? &streams_[n] : static_cast<RngBase*>(&rng_);
+      flat_rng_ = seeded_ ? &streams_[n + 1] : static_cast<RngBase*>(&rng_);
 
-      for(auto node : mcmcObjects) {
+      for(size_t i = 0; i < n; i++) {
+        MCMCObject* node = mcmcObjects[i];
+        RngBase* node_rng = seeded_ ? &streams_[i] : static_cast<RngBase*>(&rng_);
         addStochcasticNode(node);
 
+        double lower, upper;
+        const bool flatten = flat_ && node->jumpBounds(lower, upper);
+        if(flatten) {
+          flat_nodes_.push_back(node);
+        }
+
         if(node->isStochastic() && !node->isObserved()) {
           jumping_nodes.push_back(node);
+          jumping_rngs.push_back(node_rng);
+          if(!flatten) {
+            loose_jumping_nodes.push_back(node);
+            loose_jumping_rngs.push_back(node_rng);
+          }
         }
 
         if(!node->isObserved()) {
           dynamic_nodes.push_back(node);
+          if(!flatten) { loose_dynamic_nodes.push_back(node); }
         }
       }
+      order_updates();
+      for(size_t u = 0; u < updates_.size(); u++) {
+        for(size_t out = 0; out < updates_[u].outputs.size(); out++) {
+          vmc_map_iter node = data_node_map.find(const_cast<void*>(updates_[u].outputs[out]));
+          if(node != data_node_map.end()) { node->second->setDoubleBuffered(true); }
+        }
+      }
+      init_profile();
+      drop_constants();
+      flat_state_.bind(flat_nodes_);
+      reducer_.setTiming(profile_);
+      reducer_.plan(logp_functors);
+      build_effects();
+
       // init values
-      update();
+      run_updates();
     }
 
     double acceptance_ratio() const {
@@ -89,14 +610,21 @@ namespace cppbugs {
     }
 
     bool reject(const double value, const double old_logp) {
-      return bad_logp(value) || log(rng_.uniform()) > (value - old_logp) ? true : false;
+      return bad_logp(value) || log(accept_rng_->uniform()) > (value - old_logp) ? true : false;
     }
 
     double logp() const {
-      double ans(0);
-      for(auto f : logp_functors) {
-        ans += f->calc();
-      }
+      return reducer_.sum(logp_functors);
+    }
+
+    // logp() with every constant term included, for evidence, WAIC and the
+    // like; the same as logp() unless setNormalised(false)
+    double normalisedLogp() {
+      if(normalised_) { return logp(); }
+      for(size_t i = 0; i < logp_functors.size(); i++) { logp_functors[i]->dropConstants(std::vector<bool>()); }
+      double ans = logp();
+      for(size_t i = 0; i < constant_functors.size(); i++) { ans += constant_functors[i]->calc(); }
+      for(size_t i = 0; i < logp_functors.size(); i++) { logp_functors[i]->dropConstants(functor_fixed_[i]); }
       return ans;
     }
 
@@ -109,22 +637,33 @@ namespace cppbugs {
       double logp_value,old_logp_value;
       logp_value  = -std::numeric_limits<double>::infinity();
       old_logp_value = -std::numeric_limits<double>::infinity();
+      if(graph_) {
+        run_updates();
+        refresh_functor_values();
+      }
 
       for(int i = 1; i <= iterations; i++) {
-	for(auto it : jumping_nodes) {
+	for(size_t j = 0; j < jumping_nodes.size(); j++) {
+          MCMCObject* it = jumping_nodes[j];
           old_logp_value = logp_value;
           it->preserve();
-          it->jump(rng_);
-          update();
-          logp_value = logp();
+          node_jump(it, *jumping_rngs[j]);
+          if(graph_) {
+            logp_value = node_logp(j);
+          } else {
+            run_updates();
+            logp_value = logp();
+          }
           if(reject(logp_value, old_logp_value)) {
             it->revert();
+            if(graph_) { node_revert(j); }
             logp_value = old_logp_value;
             it->reject();
           } else {
             it->accept();
           }
 	}
+	profile_iterations_++;
 	if(i % tuning_step == 0) {
           //std::cout << "tuning at step: " << i << std::endl;
 	  for(auto it : jumping_nodes) {
@@ -135,10 +674,11 @@ namespace cppbugs {
     }
 
     void step() {
+      profile_iterations_++;
       old_logp_value_ = logp_value_;
       preserve();
       jump();
-      update();
+      run_updates();
       logp_value_ = logp();
       if(reject(logp_value_, old_logp_value_)) {
         revert();
@@ -163,6 +703,7 @@ namespace cppbugs {
         }
       }
       double target_ar = std::max(1/log2(total_size + 3), 0.234);
+      flat_state_.syncScales();
       for(int i = 1; i <= iterations; i++) {
         step();
         if(i % tuning_step == 0) {
@@ -173,16 +714,18 @@ namespace cppbugs {
             for(size_t i = 0; i < dynamic_nodes.size(); i++) {
               dynamic_nodes[i]->setScale(dynamic_nodes[i]->getScale() * adj_factor);
             }
+            flat_state_.syncScales();
           }
         }
       }
     }
 
     void run(int iterations, int burn, int thin) {
-      if(logp()==-std::numeric_limits<double>::infinity()) {
+      if(normalisedLogp()==-std::numeric_limits<double>::infinity()) {
         throw std::logic_error("ERROR: cannot start from a logp of -Inf.");
       }
 
+      flat_state_.syncScales();
       for(int i = 1; i <= (iterations + burn); i++) {
         step();
         if(i > burn && (i % thin == 0)) {
@@ -199,10 +742,12 @@ namespace cppbugs {
         return;
       }
 
+      if(split_.blas > 0) { set_blas_threads_local(split_.blas); }
+
       // setup logp's etc.
       initChain();
 
-      if(logp()==-std::numeric_limits<double>::infinity()) {
+      if(normalisedLogp()==-std::numeric_limits<double>::infinity()) {
         throw std::logic_error("ERROR: cannot start from a logp of -Inf.");
       }
 
@@ -216,18 +761,12 @@ namespace cppbugs {
 
     template<template<typename> class MCTYPE, typename T>
     MCTYPE<T>& track(T& x) {
-      MCTYPE<T>* node = new MCTYPE<T>(x);
-      mcmcObjects.push_back(node);
-      data_node_map[(void*)(&x)] = node;
-      return *node;
+      return *create_node<MCTYPE<T> >(x);
     }
 
     template<template<typename> class MCTYPE, typename T>
     MCTYPE<T>& track(const T& x) {
-      MCTYPE<T>* node = new MCTYPE<T>(x);
-      mcmcObjects.push_back(node);
-      data_node_map[(void*)(&x)] = node;
-      return *node;
+      return *create_node<MCTYPE<T> >(x);
     }
 
     // allows node to be added without being put on the delete list
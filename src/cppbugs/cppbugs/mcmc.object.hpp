@@ -18,6 +18,8 @@
 #ifndef MCMC_OBJECT_HPP
 #define MCMC_OBJECT_HPP
 
+#include <cstddef>
+#include <vector>
 #include <cppbugs/mcmc.rng.base.hpp>
 
 namespace cppbugs {
@@ -33,12 +35,27 @@ namespace cppbugs {
     virtual void preserve() = 0;
     virtual void revert() = 0;
     virtual void tally() = 0;
+    // the value is rewritten in full after every preserve(), so preserve and
+    // revert may swap buffers rather than copy (deterministic nodes only)
+    virtual void setDoubleBuffered(const bool double_buffered) {}
     virtual bool isDeterministc() const = 0;
     virtual bool isStochastic() const = 0;
     virtual bool isObserved() const = 0;
     virtual void setScale(const double scale) = 0;
     virtual double getScale() const = 0;
     virtual double size() const = 0;
+
+    // flat state support (see mcmc.flat.state.hpp)
+    // nodes which can take part return true and the interval their jumps must stay inside
+    virtual bool jumpBounds(double& lower, double& upper) const { return false; }
+    virtual double* bindFlat(double* mem) { return NULL; }
+    virtual void releaseFlat() {}
+
+    // model graph support (see mcmc.model.graph.hpp)
+    // where the node's value lives, NULL if unknown
+    virtual const void* valueAddress() const { return NULL; }
+    // values a deterministic node reads when it recomputes itself in jump()
+    virtual void inputs(std::vector<const void*>& out) const {}
   };
 
 } // namespace cppbugs
@@ -42,6 +42,7 @@ namespace cppbugs {
     void setScale(const double scale) {}
     double getScale() const { return 0; }
     double size() const { return 0; }
+    const void* valueAddress() const { return &value; }
   };
 
 } // namespace cppbugs
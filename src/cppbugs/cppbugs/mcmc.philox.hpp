@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_PHILOX_HPP
+#define MCMC_PHILOX_HPP
+
+#include <cstddef>
+#include <boost/cstdint.hpp>
+#include <cppbugs/mcmc.rng.base.hpp>
+
+namespace cppbugs {
+
+  // Philox4x32-10 counter based generator (Salmon et al., "Parallel random
+  // numbers: as easy as 1, 2, 3", SC11)
+  // the key is the seed, the upper half of the counter names the stream
+  // (chain, node) and the lower half counts blocks, so every (seed, chain, node)
+  // gets its own independent sequence no matter which thread draws from it
+  class PhiloxRng : public RngBase {
+  private:
+    boost::uint32_t key_[2];
+    boost::uint32_t stream_[2];
+    boost::uint64_t block_;
+    boost::uint32_t out_[4];
+    int used_;
+    bool has_spare_;
+    double spare_;
+
+    static void round(boost::uint32_t* c, const boost::uint32_t* k) {
+      const boost::uint64_t p0 = static_cast<boost::uint64_t>(0xD2511F53u) * c[0];
+      const boost::uint64_t p1 = static_cast<boost::uint64_t>(0xCD9E8D57u) * c[2];
+      const boost::uint32_t hi0 = static_cast<boost::uint32_t>(p0 >> 32), lo0 = static_cast<boost::uint32_t>(p0);
+      const boost::uint32_t hi1 = static_cast<boost::uint32_t>(p1 >> 32), lo1 = static_cast<boost::uint32_t>(p1);
+      const boost::uint32_t c1 = c[1], c3 = c[3];
+      c[0] = hi1 ^ c1 ^ k[0];
+      c[1] = lo1;
+      c[2] = hi0 ^ c3 ^ k[1];
+      c[3] = lo0;
+    }
+
+    void next_block() {
+      out_[0] = static_cast<boost::uint32_t>(block_);
+      out_[1] = static_cast<boost::uint32_t>(block_ >> 32);
+      out_[2] = stream_[0];
+      out_[3] = stream_[1];
+      philox(out_, key_);
+      ++block_;
+      used_ = 0;
+    }
+
+    boost::uint32_t next32() {
+      if(used_ == 4) { next_block(); }
+      return out_[used_++];
+    }
+  public:
+    // ten rounds of the bijection, c is replaced by its image under key k
+    static void philox(boost::uint32_t* c, const boost::uint32_t* k) {
+      boost::uint32_t key[2] = { k[0], k[1] };
+      for(int r = 0; r < 10; r++) {
+        if(r) { key[0] += 0x9E3779B9u; key[1] += 0xBB67AE85u; }
+        round(c, key);
+      }
+    }
+
+    PhiloxRng(): RngBase() { reset(0, 0, 0); }
+    PhiloxRng(const boost::uint64_t seed, const boost::uint32_t chain, const boost::uint32_t node): RngBase() { reset(seed, chain, node); }
+
+    void reset(const boost::uint64_t seed, const boost::uint32_t chain, const boost::uint32_t node) {
+      key_[0] = static_cast<boost::uint32_t>(seed);
+      key_[1] = static_cast<boost::uint32_t>(seed >> 32);
+      stream_[0] = node;
+      stream_[1] = chain;
+      block_ = 0;
+      out_[0] = out_[1] = out_[2] = out_[3] = 0;
+      used_ = 4;
+      has_spare_ = false;
+      spare_ = 0;
+    }
+
+    // 53 random bits on [0,1)
+    double uniform() {
+      const boost::uint32_t a = next32() >> 5, b = next32() >> 6;
+      return (a * 67108864.0 + b) * (1.0 / 9007199254740992.0);
+    }
+
+    double normal() {
+      if(has_spare_) {
+        has_spare_ = false;
+        return spare_;
+      }
+      double x[2] = { uniform(), uniform() };
+      box_muller(x, 2);
+      has_spare_ = true;
+      spare_ = x[1];
+      return x[0];
+    }
+
+    void fill_uniform(double* x, const size_t n) {
+      for(size_t i = 0; i < n; i++) { x[i] = uniform(); }
+    }
+
+    void fill_normal(double* x, const size_t n) {
+      const size_t even = n - n % 2;
+      fill_uniform(x, even);
+      box_muller(x, even);
+      if(even < n) { x[even] = normal(); }
+    }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_PHILOX_HPP
@@ -18,14 +18,33 @@
 #ifndef MCMC_RNG_BASE_HPP
 #define MCMC_RNG_BASE_HPP
 
+#include <cmath>
+#include <cstddef>
 
 namespace cppbugs {
 
+  // Box-Muller, in place: n (even) uniforms on [0,1) become n standard normals
+  // branch free so the compiler is free to vectorise it
+  inline void box_muller(double* x, const size_t n) {
+    const double two_pi = 2.0 * 3.14159265358979323846;
+    for(size_t i = 0; i + 1 < n; i += 2) {
+      const double r = std::sqrt(-2.0 * std::log(1.0 - x[i]));  // 1 - u is in (0,1]
+      const double theta = two_pi * x[i + 1];
+      x[i] = r * std::cos(theta);
+      x[i + 1] = r * std::sin(theta);
+    }
+  }
+
   class RngBase {
   public:
     RngBase() {}
     virtual double normal() = 0;
     virtual double uniform() = 0;
+
+    // bulk draws, one virtual call per block instead of per element
+    // generators which can do better than a loop override these
+    virtual void fill_normal(double* x, const size_t n) { for(size_t i = 0; i < n; i++) { x[i] = normal(); } }
+    virtual void fill_uniform(double* x, const size_t n) { for(size_t i = 0; i < n; i++) { x[i] = uniform(); } }
     //virtual int poisson(n) = 0;
     // etc...
   };
@@ -18,6 +18,7 @@
 #ifndef MCMC_RNG_HPP
 #define MCMC_RNG_HPP
 
+#include <cstddef>
 #include <boost/random.hpp>
 #include <cppbugs/mcmc.rng.base.hpp>
 
@@ -37,6 +38,18 @@ namespace cppbugs {
                       uniform_rng_(generator_, uniform_rng_dist_) {}
     double normal() { return normal_rng_(); }
     double uniform() { return uniform_rng_(); }
+
+    void fill_uniform(double* x, const size_t n) {
+      for(size_t i = 0; i < n; i++) { x[i] = uniform_rng_(); }
+    }
+
+    // all the uniforms are drawn first, then transformed pairwise (see box_muller)
+    void fill_normal(double* x, const size_t n) {
+      const size_t even = n - n % 2;
+      fill_uniform(x, even);
+      box_muller(x, even);
+      if(even < n) { x[even] = normal_rng_(); }
+    }
   };
 
 } // namespace cppbugs
@@ -0,0 +1,291 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_STATIC_MODEL_HPP
+#define MCMC_STATIC_MODEL_HPP
+
+#include <cmath>
+#include <limits>
+#include <iostream>
+#include <tuple>
+#include <vector>
+#include <functional>
+#include <type_traits>
+#include <stdexcept>
+#include <cppbugs/mcmc.rng.hpp>
+#include <cppbugs/mcmc.philox.hpp>
+#include <cppbugs/mcmc.object.hpp>
+#include <cppbugs/mcmc.stochastic.hpp>
+#include <cppbugs/mcmc.arena.hpp>
+#include <cppbugs/mcmc.math.hpp>
+
+namespace cppbugs {
+
+  // model whose node types are fixed at compile time
+  // nodes are held by value in a tuple and every jump/preserve/revert/tally
+  // is a qualified (non virtual) call which the compiler can inline
+  // the only indirection left is one calc() per likelihood
+  //
+  // usage:
+  //   StaticModel<boost::minstd_rand, Normal<double>, Gamma<double>, ObservedNormal<mat> > m(model, b, tau, y);
+  //   m.node<0>().dnorm(zero, one_e3);
+  template<class RNG, typename... Nodes>
+  class StaticModel {
+  private:
+    typedef std::tuple<Nodes...> node_tuple;
+    static const size_t num_nodes = sizeof...(Nodes);
+
+    double accepted_,rejected_,logp_value_,old_logp_value_;
+    SpecializedRng<RNG> rng_;
+    // per node counter based streams once seed() is called (see MCModel::seed)
+    std::vector<PhiloxRng> streams_;
+    std::vector<RngBase*> node_rngs_;
+    RngBase* accept_rng_;
+    // declared before nodes_ so the likelihood functors outlive the nodes
+    Arena arena_;
+    node_tuple nodes_;
+    std::function<void ()> update;
+
+    template<typename N>
+    static bool is_jumping(const N& n) { return n.N::isStochastic() && !n.N::isObserved(); }
+
+    template<size_t I, typename F>
+    typename std::enable_if<I == num_nodes>::type for_each(F& f) {}
+
+    // visitors are called with each node and its position in the model
+    template<size_t I, typename F>
+    typename std::enable_if<I < num_nodes>::type for_each(F& f) {
+      f(std::get<I>(nodes_), I);
+      for_each<I + 1>(f);
+    }
+
+    template<size_t I>
+    typename std::enable_if<I == num_nodes, double>::type sum_logp() const { return 0; }
+
+    template<size_t I>
+    typename std::enable_if<I < num_nodes, double>::type sum_logp() const {
+      return node_logp(std::get<I>(nodes_)) + sum_logp<I + 1>();
+    }
+
+    template<typename N>
+    static typename std::enable_if<std::is_base_of<Stochastic, N>::value, double>::type node_logp(const N& n) {
+      return n.getLikelihoodFunctor()->calc();
+    }
+
+    template<typename N>
+    static typename std::enable_if<!std::is_base_of<Stochastic, N>::value, double>::type node_logp(const N& n) {
+      return 0;
+    }
+
+    struct arena_op {
+      Arena* arena;
+      void set(Stochastic* node) const { node->setArena(arena); }
+      void set(void* node) const {}
+      template<typename N> void operator()(N& n, const size_t i) const { set(&n); }
+    };
+    struct jump_op {
+      RngBase** rngs;
+      template<typename N> void operator()(N& n, const size_t i) const { n.N::jump(*rngs[i]); }
+    };
+    struct preserve_op { template<typename N> void operator()(N& n, const size_t i) const { n.N::preserve(); } };
+    struct revert_op { template<typename N> void operator()(N& n, const size_t i) const { n.N::revert(); } };
+    struct tally_op { template<typename N> void operator()(N& n, const size_t i) const { n.N::tally(); } };
+    struct tune_op { template<typename N> void operator()(N& n, const size_t i) const { if(is_jumping(n)) { n.N::tune(); } } };
+    struct scale_op {
+      double adj_factor;
+      template<typename N> void operator()(N& n, const size_t i) const { n.N::setScale(n.N::getScale() * adj_factor); }
+    };
+    struct size_op {
+      double total_size;
+      template<typename N> void operator()(N& n, const size_t i) { if(is_jumping(n)) { total_size += n.N::size(); } }
+    };
+    struct check_op {
+      template<typename N> void operator()(N& n, const size_t i) const {
+        if(node_logp_missing(n)) {
+          throw std::logic_error("ERROR: stochastic node has no likelihood.");
+        }
+      }
+    };
+    template<typename N>
+    static typename std::enable_if<std::is_base_of<Stochastic, N>::value, bool>::type node_logp_missing(const N& n) { return n.getLikelihoodFunctor() == NULL; }
+    template<typename N>
+    static typename std::enable_if<!std::is_base_of<Stochastic, N>::value, bool>::type node_logp_missing(const N& n) { return false; }
+
+    // single node metropolis step used while tuning the individual scales
+    struct node_step_op {
+      StaticModel& m;
+      double& logp_value;
+      template<typename N> void operator()(N& n, const size_t i) const {
+        if(!is_jumping(n)) { return; }
+        const double old_logp_value = logp_value;
+        n.N::preserve();
+        n.N::jump(*m.node_rngs_[i]);
+        m.update();
+        logp_value = m.logp();
+        if(m.reject(logp_value, old_logp_value)) {
+          n.N::revert();
+          logp_value = old_logp_value;
+          n.N::reject();
+        } else {
+          n.N::accept();
+        }
+      }
+    };
+
+    void jump() { jump_op op = { &node_rngs_[0] }; for_each<0>(op); }
+    void preserve() { preserve_op op; for_each<0>(op); }
+    void revert() { revert_op op; for_each<0>(op); }
+    void tally() { tally_op op; for_each<0>(op); }
+    static bool bad_logp(const double value) { return std::isnan(value) || value == -std::numeric_limits<double>::infinity() ? true : false; }
+  public:
+    // one variable per node, in the same order as Nodes
+    template<typename... Vars>
+    StaticModel(std::function<void ()> update_, Vars&... vars): accepted_(0), rejected_(0), logp_value_(-std::numeric_limits<double>::infinity()), old_logp_value_(-std::numeric_limits<double>::infinity()), node_rngs_(num_nodes, &rng_), accept_rng_(&rng_), nodes_(vars...), update(update_) {
+      static_assert(sizeof...(Vars) == sizeof...(Nodes), "StaticModel needs exactly one variable per node.");
+      arena_op op = { &arena_ };
+      for_each<0>(op);
+      warm_math_tables();
+    }
+
+    // counter based streams keyed by (seed, chain, node position), see MCModel::seed
+    void seed(const boost::uint64_t seed, const boost::uint32_t chain = 0) {
+      streams_.clear();
+      for(size_t i = 0; i < num_nodes; i++) {
+        streams_.push_back(PhiloxRng(seed, chain, static_cast<boost::uint32_t>(i)));
+      }
+      streams_.push_back(PhiloxRng(seed, chain, 0xFFFFFFFFu));
+      for(size_t i = 0; i < num_nodes; i++) {
+        node_rngs_[i] = &streams_[i];
+      }
+      accept_rng_ = &streams_[num_nodes];
+    }
+
+    template<size_t I>
+    typename std::tuple_element<I, node_tuple>::type& node() { return std::get<I>(nodes_); }
+
+    template<size_t I>
+    const typename std::tuple_element<I, node_tuple>::type& node() const { return std::get<I>(nodes_); }
+
+    void initChain() {
+      check_op check;
+      for_each<0>(check);
+
+      // init values
+      update();
+    }
+
+    double acceptance_ratio() const {
+      return accepted_ / (accepted_ + rejected_);
+    }
+
+    bool reject(const double value, const double old_logp) {
+      return bad_logp(value) || log(accept_rng_->uniform()) > (value - old_logp) ? true : false;
+    }
+
+    double logp() const {
+      return sum_logp<0>();
+    }
+
+    void resetAcceptanceRatio() {
+      accepted_ = 0;
+      rejected_ = 0;
+    }
+
+    void tune(int iterations, int tuning_step) {
+      double logp_value = -std::numeric_limits<double>::infinity();
+      node_step_op node_step = { *this, logp_value };
+      tune_op tune_nodes;
+
+      for(int i = 1; i <= iterations; i++) {
+        for_each<0>(node_step);
+        if(i % tuning_step == 0) {
+          for_each<0>(tune_nodes);
+        }
+      }
+    }
+
+    void step() {
+      old_logp_value_ = logp_value_;
+      preserve();
+      jump();
+      update();
+      logp_value_ = logp();
+      if(reject(logp_value_, old_logp_value_)) {
+        revert();
+        logp_value_ = old_logp_value_;
+        rejected_ += 1;
+      } else {
+        accepted_ += 1;
+      }
+    }
+
+    void tune_global(int iterations, int tuning_step) {
+      const double thresh = 0.1;
+      const double dilution = 0.10;
+      size_op sizes = { 0 };
+      for_each<0>(sizes);
+
+      double target_ar = std::max(1/log2(sizes.total_size + 3), 0.234);
+      for(int i = 1; i <= iterations; i++) {
+        step();
+        if(i % tuning_step == 0) {
+          double diff = acceptance_ratio() - target_ar;
+          resetAcceptanceRatio();
+          if(std::abs(diff) > thresh) {
+            scale_op scale = { 1.0 + diff * dilution };
+            for_each<0>(scale);
+          }
+        }
+      }
+    }
+
+    void run(int iterations, int burn, int thin) {
+      if(logp()==-std::numeric_limits<double>::infinity()) {
+        throw std::logic_error("ERROR: cannot start from a logp of -Inf.");
+      }
+
+      for(int i = 1; i <= (iterations + burn); i++) {
+        step();
+        if(i > burn && (i % thin == 0)) {
+          tally();
+        }
+      }
+    }
+
+    void sample(int iterations, int burn, int adapt, int thin) {
+      if(iterations % thin) {
+        std::cout << "ERROR: interations not a multiple of thin." << std::endl;
+        return;
+      }
+
+      // setup logp's etc.
+      initChain();
+
+      if(logp()==-std::numeric_limits<double>::infinity()) {
+        throw std::logic_error("ERROR: cannot start from a logp of -Inf.");
+      }
+
+      // tuning phase
+      tune(adapt,static_cast<int>(adapt/100));
+      tune_global(adapt,static_cast<int>(adapt/100));
+
+      // sampling
+      run(iterations, burn, thin);
+    }
+  };
+} // namespace cppbugs
+#endif // MCMC_STATIC_MODEL_HPP
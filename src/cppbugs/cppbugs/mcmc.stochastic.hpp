@@ -20,6 +20,9 @@
 
 #include <limits>
 #include <cmath>
+#include <cstddef>
+#include <vector>
+#include <cppbugs/mcmc.arena.hpp>
 
 namespace cppbugs {
 
@@ -27,14 +30,42 @@ namespace cppbugs {
   public:
     virtual ~Likelihiood() {}
     virtual double calc() const = 0;
+    // number of independent terms calc() sums, 0 if it cannot be split
+    virtual size_t terms() const { return 0; }
+    // sizes any per-element caches, called once before the functor is
+    // evaluated (see LikelihoodReducer::plan); calc() is correct without it,
+    // it only recomputes what the caches would have kept
+    virtual void prepare() {}
+    // sum of terms [begin, end) only, calc() must equal calc_terms(0, terms())
+    virtual double calc_terms(const size_t begin, const size_t end) const { return calc(); }
+    // addresses of the values calc() reads, x first, nothing if unknown
+    virtual void inputs(std::vector<const void*>& out) const {}
+    // fixed[i] says inputs()[i] cannot change while sampling; terms which only
+    // depend on fixed inputs may then be left out of calc(), which is correct up
+    // to an additive constant only from then on (see MCModel::setNormalised)
+    // an empty fixed puts every term back
+    virtual void dropConstants(const std::vector<bool>& fixed) {}
   };
 
   class Stochastic {
   protected:
     Likelihiood* likelihood_functor;
+    Arena* arena_;
+
+    // functors go into the owning model's arena when there is one
+    // (the arena then destroys them), otherwise onto the heap
+    template<typename L, typename A1, typename A2>
+    void makeLikelihood(const A1& a1, const A2& a2) {
+      likelihood_functor = arena_ ? arena_->create<L>(a1, a2) : new L(a1, a2);
+    }
+    template<typename L, typename A1, typename A2, typename A3>
+    void makeLikelihood(const A1& a1, const A2& a2, const A3& a3) {
+      likelihood_functor = arena_ ? arena_->create<L>(a1, a2, a3) : new L(a1, a2, a3);
+    }
   public:
-    Stochastic() {}
-    ~Stochastic() { delete likelihood_functor; }
+    Stochastic(): likelihood_functor(NULL), arena_(NULL) {}
+    ~Stochastic() { if(!arena_) { delete likelihood_functor; } }
+    void setArena(Arena* arena) { arena_ = arena; }
     double loglik() const {
       return 
         likelihood_functor ?
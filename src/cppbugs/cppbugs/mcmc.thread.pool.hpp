@@ -0,0 +1,246 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_THREAD_POOL_HPP
+#define MCMC_THREAD_POOL_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+// worker threads need c++11, older compilers (and the R glue when built
+// as c++98) get a pool of size one which runs every task on the caller
+#if __cplusplus >= 201103L && !defined(CPPBUGS_NO_THREADS)
+#define CPPBUGS_HAVE_THREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#endif
+
+namespace cppbugs {
+
+  // one unit of work for ThreadPool::run, called once for each index
+  class ThreadTask {
+  public:
+    virtual ~ThreadTask() {}
+    virtual void operator()(const size_t i) const = 0;
+  };
+
+  // worker threads handed out process wide, so several models (one per
+  // chain, say) asking for threads at once never add up to more than the
+  // hardware has; threads which run chains are counted too once they are
+  // registered (SamplingThreads below), otherwise the calling thread is
+  // assumed to be the only one
+  class ThreadBudget {
+  private:
+    size_t used_, samplers_;
+#ifdef CPPBUGS_HAVE_THREADS
+    std::mutex mutex_;
+#endif
+    ThreadBudget(): used_(0), samplers_(0) {}
+  public:
+    static ThreadBudget& instance() {
+      static ThreadBudget budget;
+      return budget;
+    }
+
+    // CPPBUGS_MAX_THREADS overrides what the hardware reports (containers, shared hosts)
+    static size_t hardware() {
+#ifdef CPPBUGS_HAVE_THREADS
+      const char* cap = getenv("CPPBUGS_MAX_THREADS");
+      const size_t n = cap && atoi(cap) > 0 ? static_cast<size_t>(atoi(cap)) : std::thread::hardware_concurrency();
+      return n ? n : 1;
+#else
+      return 1;
+#endif
+    }
+
+    // grants at most wanted extra threads, possibly none
+    size_t acquire(const size_t wanted) {
+#ifdef CPPBUGS_HAVE_THREADS
+      std::lock_guard<std::mutex> lock(mutex_);
+#endif
+      const size_t samplers = std::max<size_t>(samplers_, 1);
+      const size_t capacity = hardware() > samplers ? hardware() - samplers : 0;
+      const size_t granted = std::min(wanted, capacity > used_ ? capacity - used_ : 0);
+      used_ += granted;
+      return granted;
+    }
+
+    void release(const size_t n) {
+#ifdef CPPBUGS_HAVE_THREADS
+      std::lock_guard<std::mutex> lock(mutex_);
+#endif
+      used_ -= std::min(n, used_);
+    }
+
+    size_t used() {
+#ifdef CPPBUGS_HAVE_THREADS
+      std::lock_guard<std::mutex> lock(mutex_);
+#endif
+      return used_;
+    }
+
+    // n more threads run chains, their cores are not handed out as workers
+    void enter(const size_t n) {
+#ifdef CPPBUGS_HAVE_THREADS
+      std::lock_guard<std::mutex> lock(mutex_);
+#endif
+      samplers_ += n;
+    }
+
+    void leave(const size_t n) {
+#ifdef CPPBUGS_HAVE_THREADS
+      std::lock_guard<std::mutex> lock(mutex_);
+#endif
+      samplers_ -= std::min(n, samplers_);
+    }
+  };
+
+  // registers the threads of a multi chain run with ThreadBudget for its
+  // lifetime; a driver starting K chains holds SamplingThreads(K) from before
+  // the chains build their models (and pools) until they have all finished
+  class SamplingThreads {
+  private:
+    size_t n_;
+    SamplingThreads(const SamplingThreads&);
+    SamplingThreads& operator=(const SamplingThreads&);
+  public:
+    explicit SamplingThreads(const size_t n): n_(n) { ThreadBudget::instance().enter(n_); }
+    ~SamplingThreads() { ThreadBudget::instance().leave(n_); }
+  };
+
+  // fixed set of workers which, together with the calling thread, run the
+  // indices of one task at a time; run() returns once every index is done
+  // workers are taken from ThreadBudget, so size() may be below what was asked for
+  class ThreadPool {
+#ifdef CPPBUGS_HAVE_THREADS
+  private:
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_, finished_;
+    const ThreadTask* task_;
+    size_t n_tasks_;
+    std::atomic<size_t> next_;
+    size_t done_, active_;
+    unsigned long generation_;
+    bool stop_;
+    std::exception_ptr error_;
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    // claims indices until none are left, returns how many it ran
+    size_t drain(const ThreadTask& task, const size_t n_tasks) {
+      size_t ran = 0;
+      for(size_t i = next_++; i < n_tasks; i = next_++) {
+        try {
+          task(i);
+        } catch(...) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if(!error_) { error_ = std::current_exception(); }
+        }
+        ++ran;
+      }
+      return ran;
+    }
+
+    void work() {
+      unsigned long seen = 0;
+      for(;;) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+        if(stop_) { return; }
+        seen = generation_;
+        const ThreadTask* task = task_;
+        const size_t n_tasks = n_tasks_;
+        ++active_;
+        lock.unlock();
+
+        const size_t ran = drain(*task, n_tasks);
+
+        lock.lock();
+        done_ += ran;
+        --active_;
+        if(done_ == n_tasks_ && active_ == 0) { finished_.notify_one(); }
+      }
+    }
+  public:
+    explicit ThreadPool(const size_t threads): task_(NULL), n_tasks_(0), next_(0), done_(0), active_(0), generation_(0), stop_(false) {
+      const size_t extra = ThreadBudget::instance().acquire(threads > 1 ? threads - 1 : 0);
+      for(size_t i = 0; i < extra; i++) {
+        workers_.push_back(std::thread(&ThreadPool::work, this));
+      }
+    }
+
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      wake_.notify_all();
+      for(size_t i = 0; i < workers_.size(); i++) { workers_[i].join(); }
+      ThreadBudget::instance().release(workers_.size());
+    }
+
+    size_t size() const { return workers_.size() + 1; }
+
+    void run(const ThreadTask& task, const size_t n_tasks) {
+      if(workers_.empty() || n_tasks < 2) {
+        for(size_t i = 0; i < n_tasks; i++) { task(i); }
+        return;
+      }
+      {
+        // a worker which woke too late for the previous task may still be
+        // on its way out, it must not see this task's indices with the old task
+        std::unique_lock<std::mutex> lock(mutex_);
+        finished_.wait(lock, [&]() { return active_ == 0; });
+        task_ = &task;
+        n_tasks_ = n_tasks;
+        next_ = 0;
+        done_ = 0;
+        error_ = std::exception_ptr();
+        ++generation_;
+      }
+      wake_.notify_all();
+
+      const size_t ran = drain(task, n_tasks);
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_ += ran;
+      finished_.wait(lock, [&]() { return done_ == n_tasks_ && active_ == 0; });
+      if(error_) {
+        std::exception_ptr e = error_;
+        error_ = std::exception_ptr();
+        std::rethrow_exception(e);
+      }
+    }
+#else
+  public:
+    explicit ThreadPool(const size_t threads) {}
+    size_t size() const { return 1; }
+    void run(const ThreadTask& task, const size_t n_tasks) {
+      for(size_t i = 0; i < n_tasks; i++) { task(i); }
+    }
+#endif
+  };
+
+} // namespace cppbugs
+#endif // MCMC_THREAD_POOL_HPP
@@ -0,0 +1,54 @@
+#include <iostream>
+#include <armadillo>
+#include <boost/cstdint.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <cppbugs/cppbugs.hpp>
+
+using namespace arma;
+using namespace cppbugs;
+using std::cout;
+using std::endl;
+
+// built with -march=native (see the Makefile), where arma's members may be
+// aligned to 32 or 64 bytes: every object the arena hands out, and every
+// node a model tracks, must sit on a multiple of its type's alignment
+struct alignas(64) Wide {
+  double x[8];
+  Wide(const double v, const double w) { x[0] = v; x[1] = w; }
+};
+
+template<typename T>
+bool aligned(const T* p) {
+  return reinterpret_cast<boost::uintptr_t>(p) % boost::alignment_of<T>::value == 0;
+}
+
+int main() {
+  bool ok = true;
+
+  Arena arena;
+  for(int i = 0; i < 1000; i++) {
+    // odd sizes in between push the head off any larger boundary
+    char tag = static_cast<char>(i);
+    const char* c = arena.create<char>(tag);
+    const Wide* w = arena.create<Wide>(static_cast<double>(i), -1.0);
+    ok = ok && aligned(c) && aligned(w) && *c == tag && w->x[0] == i && w->x[1] == -1.0;
+  }
+  cout << "arena objects aligned: " << ok << " (Wide needs " << boost::alignment_of<Wide>::value << ")" << endl;
+
+  const double zero(0), one_e3(0.001);
+  vec b(10); b.fill(0);
+  double tau(1);
+  MCModel<boost::minstd_rand> m;
+  bool nodes = true;
+  nodes = nodes && aligned(&m.track<Normal>(tau).dnorm(zero, one_e3));
+  nodes = nodes && aligned(&m.track<Normal>(b).dnorm(zero, one_e3));
+  cout << "vec node aligned: " << nodes << " (Normal<vec> needs " << boost::alignment_of<Normal<vec> >::value << ")" << endl;
+  ok = ok && nodes;
+
+  if(!ok) {
+    cout << "FAILED" << endl;
+    return 1;
+  }
+  cout << "passed" << endl;
+  return 0;
+};
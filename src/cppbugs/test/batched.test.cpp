@@ -0,0 +1,108 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <thread>
+#include <armadillo>
+#include <cppbugs/cppbugs.hpp>
+#include <cppbugs/mcmc.batched.linear.hpp>
+
+using namespace arma;
+using namespace cppbugs;
+using std::cout;
+using std::endl;
+
+// the batched product (gemm) and X * b (gemv) may round differently in an
+// optimised blas, so predictions are compared within a tolerance and chains,
+// which drift apart after the first last-bit difference, by their means
+void run_chain(const mat& X, const mat& y, const int chain, BatchedLinearPredictor* batch, std::vector<double>& ans) {
+  // leaves the batch however sample() ends, so the other chains never wait for this one
+  BatchedChain seat(batch, chain);
+  const double zero(0), one_e1(0.1), one_e3(0.001);
+  vec b(X.n_cols); b.fill(0);
+  double tau(1);
+  mat y_hat;
+
+  std::function<void ()> model = [&]() {
+    if(batch) {
+      batch->predict(chain, b, y_hat);
+    } else {
+      y_hat = X * b;
+    }
+  };
+
+  MCModel<boost::minstd_rand> m(model);
+  m.seed(20120601, chain);
+  m.track<Normal>(b).dnorm(zero, one_e3);
+  m.track<Gamma>(tau).dgamma(one_e1,one_e1);
+  m.track<ObservedNormal>(y).dnorm(y_hat,tau);
+  m.sample(1e3, 1e3, 1e3, 1);
+
+  ans.assign(X.n_cols, 0);
+  for(std::list<vec>::const_iterator it = m.getNode(b).history.begin(); it != m.getNode(b).history.end(); it++) {
+    for(uword j = 0; j < X.n_cols; j++) { ans[j] += (*it)[j] / m.getNode(b).history.size(); }
+  }
+}
+
+// chain k predicts with its own b in each of rounds lockstep calls
+void predict_rounds(const mat& X, const int chain, const int rounds, BatchedLinearPredictor* batch, double& worst) {
+  BatchedChain seat(batch, chain);
+  vec b(X.n_cols);
+  mat out;
+  worst = 0;
+  for(int r = 0; r < rounds; r++) {
+    for(uword j = 0; j < X.n_cols; j++) { b[j] = std::sin(1.0 + chain + 0.37 * r + 1.91 * j); }
+    batch->predict(chain, b, out);
+    const mat want = X * b;
+    for(uword i = 0; i < X.n_rows; i++) { worst = std::max(worst, std::abs(out[i] - want[i]) / (1 + std::abs(want[i]))); }
+  }
+}
+
+int main() {
+  const int NR = 1e3;
+  const int NC = 3;
+  const int chains = 3;
+  mat X = randn<mat>(NR,NC);
+  X.col(0).fill(1);
+  const mat y = X * randn<vec>(NC) + randn<mat>(NR,1);
+
+  SamplingThreads chain_threads(chains);
+  int failures = 0;
+  {
+    BatchedLinearPredictor batch(X, chains);
+    std::vector<double> worst(chains);
+    std::vector<std::thread> threads;
+    for(int k = 0; k < chains; k++) {
+      threads.push_back(std::thread(predict_rounds, std::cref(X), k, 50 + 10 * k, &batch, std::ref(worst[k])));
+    }
+    for(int k = 0; k < chains; k++) { threads[k].join(); }
+    for(int k = 0; k < chains; k++) {
+      const bool close = worst[k] < 1e-12;
+      cout << "chain " << k << " batched predictions match X * b: " << close << endl;
+      if(!close) { ++failures; }
+    }
+  }
+
+  BatchedLinearPredictor batch(X, chains);
+  std::vector< std::vector<double> > batched(chains);
+  std::vector<std::thread> threads;
+  for(int k = 0; k < chains; k++) {
+    threads.push_back(std::thread(run_chain, std::cref(X), std::cref(y), k, &batch, std::ref(batched[k])));
+  }
+  for(int k = 0; k < chains; k++) { threads[k].join(); }
+
+  for(int k = 0; k < chains; k++) {
+    std::vector<double> alone;
+    run_chain(X, y, k, NULL, alone);
+    bool close = true;
+    for(size_t j = 0; j < alone.size(); j++) { close = close && std::abs(alone[j] - batched[k][j]) < 0.05; }
+    cout << "chain " << k << " batched posterior mean matches unbatched: " << close << endl;
+    if(!close) { ++failures; }
+  }
+
+  if(failures) {
+    cout << "FAILED" << endl;
+    return 1;
+  }
+  cout << "passed" << endl;
+  return 0;
+};
@@ -0,0 +1,47 @@
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <armadillo>
+#include <cppbugs/cppbugs.hpp>
+
+using namespace arma;
+using namespace cppbugs;
+using std::cout;
+using std::endl;
+
+// every isa level this cpu supports must agree bit for bit with the baseline kernels
+int main() {
+  const char* levels[] = { "avx2", "avx512f" };
+  kernel_table baseline;
+  kernels_for("baseline", baseline);
+  cout << "dispatched: " << kernels().isa << endl;
+
+  int failures = 0;
+  for(size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+    kernel_table k;
+    if(!kernels_for(levels[l], k)) {
+      cout << levels[l] << ": not available" << endl;
+      continue;
+    }
+    bool same = true;
+    for(size_t n = 0; n < 100; n++) {
+      const vec x = randn<vec>(n), mu = randn<vec>(n);
+      same = same && baseline.sum_sq_diff(x.memptr(), mu.memptr(), n) == k.sum_sq_diff(x.memptr(), mu.memptr(), n);
+
+      vec y0 = randn<vec>(n);
+      vec y1 = y0;
+      baseline.axpy(y0.memptr(), 0.37, x.memptr(), n);
+      k.axpy(y1.memptr(), 0.37, x.memptr(), n);
+      same = same && memcmp(y0.memptr(), y1.memptr(), sizeof(double) * n) == 0;
+    }
+    cout << levels[l] << " matches baseline: " << same << endl;
+    if(!same) { ++failures; }
+  }
+
+  if(failures) {
+    cout << "FAILED" << endl;
+    return 1;
+  }
+  cout << "passed" << endl;
+  return 0;
+};
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include <armadillo>
+#include <cppbugs/cppbugs.hpp>
+
+using namespace cppbugs;
+using std::cout;
+using std::endl;
+
+// poly_math against long double libm over the domains its error bounds are
+// stated for (see the math policies in mcmc.math.hpp), plus nan and +inf
+struct Sweep {
+  const char* name;
+  double worst, bound;
+  Sweep(const char* name_, const double bound_): name(name_), worst(0), bound(bound_) {}
+  void rel(const double got, const long double want) {
+    if(want != 0) { note(std::fabs((got - want) / want)); }
+  }
+  void abs(const double got, const long double want) { note(std::fabs(got - want)); }
+  void note(const long double err) { if(err > worst) { worst = static_cast<double>(err); } }
+  bool report() const {
+    cout << name << ": worst " << worst << " bound " << bound << endl;
+    return worst < bound;
+  }
+};
+
+int main() {
+  const double inf = std::numeric_limits<double>::infinity();
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  bool ok = true;
+
+  // every binade from the smallest subnormal up, 64 mantissas in each
+  Sweep log("log", 1e-15);
+  for(int e = -1074; e <= 1023; e++) {
+    for(int j = 0; j < 64; j++) {
+      const double x = std::ldexp(1.0 + j / 64.0, e);
+      if(x == inf) { continue; }
+      log.rel(poly_math::log(x), std::log(static_cast<long double>(x)));
+    }
+  }
+  ok = log.report() && ok;
+
+  Sweep log1p("log1p", 1e-15);
+  for(double x = -0.999; x < 10; x += 0.0007) { log1p.rel(poly_math::log1p(x), log1pl(x)); }
+  for(int e = -60; e < 0; e++) { log1p.rel(poly_math::log1p(std::ldexp(1.0, e)), log1pl(std::ldexp(1.0L, e))); }
+  ok = log1p.report() && ok;
+
+  Sweep exp("exp", 1e-15);
+  for(double x = -707.9; x < 708; x += 0.0131) { exp.rel(poly_math::exp(x), std::exp(static_cast<long double>(x))); }
+  ok = exp.report() && ok;
+
+  Sweep lgamma("lgamma", 1e-12);
+  for(double x = 1e-3; x < 100; x += 0.00731) { lgamma.abs(poly_math::lgamma(x), lgammal(x)); }
+  ok = lgamma.report() && ok;
+
+  Sweep lgamma_large("lgamma (large x)", 1e-15);
+  for(double x = 100; x < 1e7; x *= 1.0013) { lgamma_large.rel(poly_math::lgamma(x), lgammal(x)); }
+  ok = lgamma_large.report() && ok;
+
+  Sweep log_sigmoid("log_sigmoid", 1e-14);
+  for(double x = -700; x < 700; x += 0.0173) {
+    log_sigmoid.abs(poly_math::log_sigmoid(x), -log1pl(std::exp(static_cast<long double>(-x))));
+  }
+  ok = log_sigmoid.report() && ok;
+
+  // non-finite inputs behave like libm
+  bool passthrough = true;
+  passthrough = passthrough && poly_math::log(inf) == inf && poly_math::log(nan) != poly_math::log(nan);
+  passthrough = passthrough && poly_math::log(0.0) == -inf;
+  passthrough = passthrough && poly_math::log1p(inf) == inf && poly_math::log1p(nan) != poly_math::log1p(nan);
+  passthrough = passthrough && poly_math::exp(inf) == inf && poly_math::exp(-inf) == 0 && poly_math::exp(nan) != poly_math::exp(nan);
+  passthrough = passthrough && poly_math::lgamma(inf) == inf && poly_math::lgamma(nan) != poly_math::lgamma(nan);
+  cout << "non-finite pass through: " << passthrough << endl;
+  ok = passthrough && ok;
+
+  if(!ok) {
+    cout << "FAILED" << endl;
+    return 1;
+  }
+  cout << "passed" << endl;
+  return 0;
+};
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <armadillo>
+#include <cppbugs/cppbugs.hpp>
+
+using namespace arma;
+using namespace cppbugs;
+using std::cout;
+using std::endl;
+
+// an unnormalised model must differ from the normalised one by a constant:
+// the prior normalisers (hyperparameters declared with setConstant) and the
+// fully observed likelihood of z, which has no varying input at all
+// w reads a precision the update function computes without tracking it (like
+// phi in herd.cpp), which must be taken as varying and kept whole
+struct Chain {
+  double logp, normalised_logp;
+  vec b_mean;
+};
+
+Chain run_chain(const mat& X, const mat& y, const mat& z, const mat& w, const bool normalised) {
+  const double zero(0), one(1), one_e1(0.1), one_e3(0.001);
+  vec b(X.n_cols); b.fill(0);
+  double tau(1), w_tau(2);
+  mat y_hat;
+
+  std::function<void ()> model = [&]() {
+    y_hat = X * b;
+    w_tau = 2 * tau;
+  };
+
+  MCModel<boost::minstd_rand> m(model);
+  m.seed(20121003);
+  m.setNormalised(normalised);
+  m.setConstant(zero);
+  m.setConstant(one);
+  m.setConstant(one_e1);
+  m.setConstant(one_e3);
+  m.track<Normal>(b).dnorm(zero, one_e3);
+  m.track<Gamma>(tau).dgamma(one_e1,one_e1);
+  m.track<Deterministic>(y_hat);
+  m.track<ObservedNormal>(y).dnorm(y_hat,tau);
+  m.track<ObservedNormal>(z).dnorm(zero,one);
+  m.track<ObservedNormal>(w).dnorm(zero,w_tau);
+  m.sample(1e4, 1e3, 1e3, 10);
+
+  Chain ans;
+  ans.logp = m.logp();
+  ans.normalised_logp = m.normalisedLogp();
+  ans.b_mean = m.getNode(b).mean();
+  return ans;
+}
+
+int main() {
+  const int NR = 1e2;
+  const int NC = 2;
+  mat X = mat(NR,NC);
+  X.col(0).fill(1);
+  X.col(1) = randn<mat>(NR,1);
+  const mat y = X * randn<vec>(NC) + randn<mat>(NR,1);
+  const mat z = randn<mat>(NR,1);
+  const mat w = randn<mat>(NR,1) / 2;
+
+  const Chain full = run_chain(X, y, z, w, true);
+  const Chain part = run_chain(X, y, z, w, false);
+
+  // what the unnormalised model leaves out
+  double dropped = NC * normal_hyper_term<default_math>::calc(0.001, 0);
+  dropped += gamma_hyper_term<default_math>::calc(0.1, 0.1);
+  dropped += normal_logp(z, 0.0, 1.0);
+
+  const bool same_value = full.logp == full.normalised_logp;
+  const bool constant = std::abs(part.normalised_logp - part.logp - dropped) < 1e-8 * std::abs(dropped);
+  bool same_posterior = true;
+  for(uword i = 0; i < full.b_mean.n_elem; i++) {
+    same_posterior = same_posterior && std::abs(full.b_mean[i] - part.b_mean[i]) < 0.05;
+  }
+  cout << "normalised logp unchanged: " << same_value << endl;
+  cout.precision(12);
+  cout << "dropped terms: " << part.normalised_logp - part.logp << " expected: " << dropped << endl;
+  cout << "b means: " << full.b_mean[0] << " " << full.b_mean[1] << " / " << part.b_mean[0] << " " << part.b_mean[1] << endl;
+
+  if(!same_value || !constant || !same_posterior) {
+    cout << "FAILED" << endl;
+    return 1;
+  }
+  cout << "passed" << endl;
+  return 0;
+};
@@ -0,0 +1,107 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <armadillo>
+#include <boost/random.hpp>
+#include <cppbugs/cppbugs.hpp>
+#include <cppbugs/mcmc.static.model.hpp>
+#include <cppbugs/mcmc.model.hpp>
+
+using namespace arma;
+using namespace cppbugs;
+using std::cout;
+using std::endl;
+
+// the price model of price.cpp with its node types fixed at compile time
+// (StaticModel) must give the chain MCModel gives from the same seed
+struct Chain {
+  std::vector<double> a, b, tau;
+  double ar;
+};
+
+template<typename N>
+std::vector<double> history(const N& node) {
+  return std::vector<double>(node.history.begin(), node.history.end());
+}
+
+// the models add the likelihoods in a different order, so their logps may
+// differ in the last bit; allow for that rather than demand identical bits
+bool same_trace(const std::vector<double>& x, const std::vector<double>& y) {
+  if(x.size() != y.size() || x.empty()) { return false; }
+  for(size_t i = 0; i < x.size(); i++) {
+    if(std::abs(x[i] - y[i]) > 1e-9 * std::max(std::abs(x[i]), 1.0)) { return false; }
+  }
+  return true;
+}
+
+int main() {
+  const double zero(0), one_e1(0.1), one_e3(0.001);
+
+  // setup data
+  double ageraw[] = {13, 14, 14,12, 9, 15, 10, 14, 9, 14, 13, 12, 9, 10, 15, 11, 15, 11, 7,
+                     13, 13, 10, 9, 6, 11, 15, 13, 10, 9, 9, 15, 14, 14, 10, 14, 11, 13, 14, 10};
+  double priceraw[] = {2950, 2300, 3900, 2800, 5000, 2999, 3950, 2995, 4500, 2800, 1990, 3500, 5100, 3900, 2900,
+                       4950, 2000, 3400, 8999, 4000, 2950, 3250, 3950, 4600, 4500, 1600, 3900, 4200, 6500, 3500, 2999, 2600, 3250, 2500, 2400, 3990, 4600, 450,4700};
+  const mat age(ageraw,39,1);
+  const mat price_r(priceraw,39,1);
+  const mat price(price_r/1000);
+  const int iterations = 1e5;
+
+  Chain dynamic;
+  {
+    double a(0), b(0), tau(1);
+    mat y_hat;
+    std::function<void ()> model = [&]() {
+      y_hat = a + b * age;
+    };
+
+    MCModel<boost::minstd_rand> m(model);
+    m.seed(20121003);
+    m.track<Normal>(a).dnorm(zero, one_e3);
+    m.track<Normal>(b).dnorm(zero, one_e3);
+    m.track<Gamma>(tau).dgamma(one_e1,one_e1);
+    m.track<ObservedNormal>(price).dnorm(y_hat,tau);
+    m.sample(iterations, 1e4, 1e4, 5);
+    dynamic.a = history(m.getNode(a));
+    dynamic.b = history(m.getNode(b));
+    dynamic.tau = history(m.getNode(tau));
+    dynamic.ar = m.acceptance_ratio();
+  }
+
+  Chain fixed;
+  {
+    double a(0), b(0), tau(1);
+    mat y_hat;
+    std::function<void ()> model = [&]() {
+      y_hat = a + b * age;
+    };
+
+    StaticModel<boost::minstd_rand, Normal<double>, Normal<double>, Gamma<double>, ObservedNormal<mat> > m(model, a, b, tau, price);
+    m.seed(20121003);
+    m.node<0>().dnorm(zero, one_e3);
+    m.node<1>().dnorm(zero, one_e3);
+    m.node<2>().dgamma(one_e1,one_e1);
+    m.node<3>().dnorm(y_hat,tau);
+    m.sample(iterations, 1e4, 1e4, 5);
+    fixed.a = history(m.node<0>());
+    fixed.b = history(m.node<1>());
+    fixed.tau = history(m.node<2>());
+    fixed.ar = m.acceptance_ratio();
+
+    cout << "a: " << m.node<0>().mean() << endl;
+    cout << "b: " << m.node<1>().mean() << endl;
+    cout << "tau: " << m.node<2>().mean() << endl;
+    cout << "samples: " << m.node<1>().history.size() << endl;
+    cout << "acceptance_ratio: " << m.acceptance_ratio() << endl;
+  }
+
+  const bool same = same_trace(dynamic.a, fixed.a) && same_trace(dynamic.b, fixed.b) && same_trace(dynamic.tau, fixed.tau) && dynamic.ar == fixed.ar;
+  cout << "same chain as MCModel: " << same << endl;
+  if(!same) {
+    cout << "FAILED" << endl;
+    return 1;
+  }
+  cout << "passed" << endl;
+  return 0;
+};
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <armadillo>
+#include <cppbugs/cppbugs.hpp>
+
+using namespace arma;
+using namespace cppbugs;
+using std::cout;
+using std::endl;
+
+// two chains with the same (seed, chain) must be bit identical,
+// a different chain id must give a different chain
+std::vector<double> run_chain(const mat& X, const mat& y, const int chain, const bool flat) {
+  const double zero(0), one_e1(0.1), one_e3(0.001);
+  vec b(X.n_cols); b.fill(0);
+  double tau(1);
+  mat y_hat;
+
+  std::function<void ()> model = [&]() {
+    y_hat = X * b;
+  };
+
+  MCModel<boost::minstd_rand> m(model);
+  m.seed(20120601, chain);
+  m.setFlatState(flat);
+  m.track<Normal>(b).dnorm(zero, one_e3);
+  m.track<Gamma>(tau).dgamma(one_e1,one_e1);
+  m.track<ObservedNormal>(y).dnorm(y_hat,tau);
+  m.sample(1e4, 1e3, 1e3, 10);
+
+  std::vector<double> ans;
+  for(std::list<vec>::const_iterator it = m.getNode(b).history.begin(); it != m.getNode(b).history.end(); it++) {
+    ans.insert(ans.end(), it->memptr(), it->memptr() + it->n_elem);
+  }
+  for(std::list<double>::const_iterator it = m.getNode(tau).history.begin(); it != m.getNode(tau).history.end(); it++) {
+    ans.push_back(*it);
+  }
+  return ans;
+}
+
+// column means of a chain laid out as run_chain returns it: n_b values of b
+// per draw, then one tau per draw
+std::vector<double> posterior_means(const std::vector<double>& chain, const size_t n_b, std::vector<double>& sds) {
+  const size_t draws = chain.size() / (n_b + 1);
+  std::vector<double> sum(n_b + 1, 0), sum_sq(n_b + 1, 0);
+  for(size_t d = 0; d < draws; d++) {
+    for(size_t j = 0; j <= n_b; j++) {
+      const double x = j < n_b ? chain[d * n_b + j] : chain[draws * n_b + d];
+      sum[j] += x;
+      sum_sq[j] += x * x;
+    }
+  }
+  std::vector<double> ans(n_b + 1);
+  sds.resize(n_b + 1);
+  for(size_t j = 0; j <= n_b; j++) {
+    ans[j] = sum[j] / draws;
+    sds[j] = std::sqrt(std::max(sum_sq[j] / draws - ans[j] * ans[j], 0.0));
+  }
+  return ans;
+}
+
+int main() {
+  const int NR = 1e2;
+  const int NC = 2;
+  mat X = mat(NR,NC);
+  X.col(0).fill(1);
+  X.col(1) = randn<mat>(NR,1);
+  const mat y = X * randn<vec>(NC) + randn<mat>(NR,1);
+
+  int failures = 0;
+  for(int flat = 0; flat < 2; flat++) {
+    const bool same = run_chain(X, y, 0, flat) == run_chain(X, y, 0, flat);
+    const bool different = run_chain(X, y, 0, flat) != run_chain(X, y, 1, flat);
+    cout << (flat ? "flat" : "nodes") << " same seed reproduces: " << same << " other chain differs: " << different << endl;
+    if(!same || !different) { ++failures; }
+  }
+
+  // the flat block jumps every parameter at once (redrawing tau until it is
+  // positive) while the node path jumps them one by one, so the chains differ
+  // but must sample the same posterior: the means of b (a vec) and tau (a
+  // bounded Gamma) must agree to a fraction of a posterior sd
+  {
+    mat Xf = mat(NR,NC);
+    mat yf = mat(NR,1);
+    for(int i = 0; i < NR; i++) {
+      Xf(i,0) = 1;
+      Xf(i,1) = std::sin(0.37 * i);
+      yf(i,0) = 1 - 2 * Xf(i,1) + 0.5 * std::sin(12.9898 * i);
+    }
+    std::vector<double> sds, flat_sds;
+    const std::vector<double> nodes = posterior_means(run_chain(Xf, yf, 0, false), NC, sds);
+    const std::vector<double> flat = posterior_means(run_chain(Xf, yf, 0, true), NC, flat_sds);
+    bool close = true;
+    for(size_t j = 0; j < nodes.size(); j++) {
+      cout << (j < static_cast<size_t>(NC) ? "b" : "tau") << " mean: nodes " << nodes[j] << " flat " << flat[j] << " sd " << sds[j] << endl;
+      close = close && std::abs(nodes[j] - flat[j]) < 0.25 * sds[j];
+    }
+    cout << "flat matches nodes: " << close << endl;
+    if(!close) { ++failures; }
+  }
+
+  if(failures) {
+    cout << "FAILED" << endl;
+    return 1;
+  }
+  cout << "passed" << endl;
+  return 0;
+};
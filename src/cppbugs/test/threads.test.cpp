@@ -0,0 +1,142 @@
+#include <iostream>
+#include <vector>
+#include <armadillo>
+#include <cppbugs/cppbugs.hpp>
+
+using namespace arma;
+using namespace cppbugs;
+using std::cout;
+using std::endl;
+
+// a likelihood larger than one block, or several smaller ones, must give
+// the same chain whatever the number of threads they are spread over
+std::vector<double> run_chain(const mat& X, const mat& y, const size_t threads) {
+  const double zero(0), one_e1(0.1), one_e3(0.001);
+  vec b(X.n_cols); b.fill(0);
+  double tau(1);
+  mat y_hat;
+
+  std::function<void ()> model = [&]() {
+    y_hat = X * b;
+  };
+
+  MCModel<boost::minstd_rand> m(model);
+  m.seed(20120601);
+  m.setThreads(threads);
+  m.track<Normal>(b).dnorm(zero, one_e3);
+  m.track<Gamma>(tau).dgamma(one_e1,one_e1);
+  m.track<ObservedNormal>(y).dnorm(y_hat,tau);
+  m.sample(200, 100, 100, 1);
+
+  std::vector<double> ans;
+  for(std::list<vec>::const_iterator it = m.getNode(b).history.begin(); it != m.getNode(b).history.end(); it++) {
+    ans.insert(ans.end(), it->memptr(), it->memptr() + it->n_elem);
+  }
+  for(std::list<double>::const_iterator it = m.getNode(tau).history.begin(); it != m.getNode(tau).history.end(); it++) {
+    ans.push_back(*it);
+  }
+  return ans;
+}
+
+// several independent observed blocks, each evaluated as its own task;
+// declared has every block's prediction as its own update, so each jump
+// goes through the plan of the likelihoods it touches instead of logp()
+std::vector<double> run_blocks(const std::vector<mat>& X, const std::vector<mat>& y, const size_t threads, const bool declared) {
+  const double zero(0), one_e1(0.1), one_e3(0.001);
+  vec b(X[0].n_cols); b.fill(0);
+  double tau(1);
+  std::vector<mat> y_hat(X.size());
+
+  std::function<void ()> model = [&]() {
+    for(size_t i = 0; i < X.size(); i++) { y_hat[i] = X[i] * b; }
+  };
+
+  MCModel<boost::minstd_rand> m(declared ? std::function<void ()>() : model);
+  if(declared) {
+    for(size_t i = 0; i < X.size(); i++) {
+      mat& y_hat_i = y_hat[i];
+      const mat& X_i = X[i];
+      m.addUpdate([&y_hat_i, &X_i, &b]() { y_hat_i = X_i * b; }, {&b}, {&y_hat_i});
+    }
+  }
+  m.seed(20120601);
+  m.setThreads(threads);
+  m.track<Normal>(b).dnorm(zero, one_e3);
+  m.track<Gamma>(tau).dgamma(one_e1,one_e1);
+  for(size_t i = 0; i < X.size(); i++) {
+    m.track<ObservedNormal>(y[i]).dnorm(y_hat[i],tau);
+  }
+  m.sample(200, 100, 100, 1);
+
+  std::vector<double> ans;
+  for(std::list<vec>::const_iterator it = m.getNode(b).history.begin(); it != m.getNode(b).history.end(); it++) {
+    ans.insert(ans.end(), it->memptr(), it->memptr() + it->n_elem);
+  }
+  for(std::list<double>::const_iterator it = m.getNode(tau).history.begin(); it != m.getNode(tau).history.end(); it++) {
+    ans.push_back(*it);
+  }
+  return ans;
+}
+
+int main() {
+  const int NR = 5 * likelihood_block_size + 123;
+  const int NC = 2;
+  mat X = mat(NR,NC);
+  X.col(0).fill(1);
+  X.col(1) = randn<mat>(NR,1);
+  const mat y = X * randn<vec>(NC) + randn<mat>(NR,1);
+
+  const std::vector<double> serial = run_chain(X, y, 1);
+  int failures = 0;
+  for(size_t threads = 2; threads <= 4; threads++) {
+    const bool same = run_chain(X, y, threads) == serial;
+    cout << threads << " threads match serial: " << same << endl;
+    if(!same) { ++failures; }
+  }
+
+  std::vector<mat> Xs, ys;
+  const vec beta = randn<vec>(NC);
+  for(int i = 0; i < 6; i++) {
+    mat Xi = mat(10000,NC);
+    Xi.col(0).fill(1);
+    Xi.col(1) = randn<mat>(10000,1);
+    Xs.push_back(Xi);
+    ys.push_back(Xi * beta + randn<mat>(10000,1));
+  }
+  const std::vector<double> serial_blocks = run_blocks(Xs, ys, 1, false);
+  for(size_t threads = 2; threads <= 4; threads++) {
+    const bool same = run_blocks(Xs, ys, threads, false) == serial_blocks;
+    cout << threads << " threads, independent blocks match serial: " << same << endl;
+    if(!same) { ++failures; }
+  }
+  const std::vector<double> serial_declared = run_blocks(Xs, ys, 1, true);
+  for(size_t threads = 2; threads <= 4; threads++) {
+    const bool same = run_blocks(Xs, ys, threads, true) == serial_declared;
+    cout << threads << " threads, declared updates match serial: " << same << endl;
+    if(!same) { ++failures; }
+  }
+
+  // four chains on eight cores: two cores each, shared by likelihood and blas
+  const ThreadSplit split = split_threads(4, 8);
+  const bool split_ok = split.chains == 4 && split.likelihood == 2 && split.blas == 2;
+  cout << "split of 8 cores over 4 chains: " << split.likelihood << " likelihood, " << split.blas << " blas" << endl;
+  if(!split_ok) { ++failures; }
+
+  // with as many chains registered as there are cores, a pool gets no
+  // workers: the chains already use every core
+  {
+    const size_t cores = ThreadBudget::hardware();
+    const size_t alone = ThreadPool(cores).size();
+    SamplingThreads chains(cores);
+    const size_t beside_chains = ThreadPool(cores).size();
+    cout << "pool of " << cores << ": " << alone << " threads alone, " << beside_chains << " beside " << cores << " chains" << endl;
+    if(alone != cores || beside_chains != 1) { ++failures; }
+  }
+
+  if(failures) {
+    cout << "FAILED" << endl;
+    return 1;
+  }
+  cout << "passed" << endl;
+  return 0;
+};
@@ -0,0 +1,70 @@
+#include <iostream>
+#include <vector>
+#include <armadillo>
+#include <cppbugs/cppbugs.hpp>
+
+using namespace arma;
+using namespace cppbugs;
+using std::cout;
+using std::endl;
+
+// a model described with declared updates must give the same chain as the
+// same model with one update function, while running the linear predictor
+// only when b has moved
+std::vector<double> run_chain(const mat& X, const mat& y, const bool declared, int& predictions) {
+  const double zero(0), one_e1(0.1), one_e3(0.001);
+  vec b(X.n_cols); b.fill(0);
+  double tau(1), sigma(1);
+  mat y_hat;
+
+  std::function<void ()> predict = [&]() {
+    ++predictions;
+    y_hat = X * b;
+  };
+  std::function<void ()> scale = [&]() {
+    sigma = 1 / sqrt(tau);
+  };
+
+  MCModel<boost::minstd_rand> m(declared ? std::function<void ()>() : [&]() { predict(); scale(); });
+  if(declared) {
+    m.addUpdate(scale, {&tau}, {&sigma});
+    m.addUpdate(predict, {&b}, {&y_hat});
+  }
+  m.seed(20121101);
+  m.track<Normal>(b).dnorm(zero, one_e3);
+  m.track<Gamma>(tau).dgamma(one_e1,one_e1);
+  m.track<Deterministic>(y_hat);
+  m.track<Deterministic>(sigma);
+  m.track<ObservedNormal>(y).dnorm(y_hat,tau);
+  m.sample(1e3, 1e3, 1e3, 10);
+
+  std::vector<double> ans;
+  for(std::list<vec>::const_iterator it = m.getNode(b).history.begin(); it != m.getNode(b).history.end(); it++) {
+    ans.insert(ans.end(), it->memptr(), it->memptr() + it->n_elem);
+  }
+  for(std::list<double>::const_iterator it = m.getNode(sigma).history.begin(); it != m.getNode(sigma).history.end(); it++) {
+    ans.push_back(*it);
+  }
+  return ans;
+}
+
+int main() {
+  const int NR = 1e2;
+  const int NC = 2;
+  mat X = mat(NR,NC);
+  X.col(0).fill(1);
+  X.col(1) = randn<mat>(NR,1);
+  const mat y = X * randn<vec>(NC) + randn<mat>(NR,1);
+
+  int single = 0, declared = 0;
+  const bool same = run_chain(X, y, false, single) == run_chain(X, y, true, declared);
+  cout << "same chain: " << same << endl;
+  cout << "predictions: " << single << " update function, " << declared << " declared" << endl;
+
+  if(!same || declared >= single) {
+    cout << "FAILED" << endl;
+    return 1;
+  }
+  cout << "passed" << endl;
+  return 0;
+};
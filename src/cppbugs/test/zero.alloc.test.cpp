@@ -0,0 +1,110 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <armadillo>
+#include <cppbugs/cppbugs.hpp>
+
+using namespace arma;
+using namespace cppbugs;
+using std::cout;
+using std::endl;
+
+// counts every heap allocation made while counting is switched on
+// by interposing malloc and friends (glibc only)
+#ifdef __GLIBC__
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t n, size_t size);
+  void* __libc_realloc(void* p, size_t size);
+  void* __libc_memalign(size_t alignment, size_t size);
+}
+
+static bool counting = false;
+static size_t allocations = 0;
+
+extern "C" {
+  void* malloc(size_t size) { if(counting) { ++allocations; } return __libc_malloc(size); }
+  void* calloc(size_t n, size_t size) { if(counting) { ++allocations; } return __libc_calloc(n, size); }
+  void* realloc(void* p, size_t size) { if(counting) { ++allocations; } return __libc_realloc(p, size); }
+  int posix_memalign(void** p, size_t alignment, size_t size) {
+    if(counting) { ++allocations; }
+    *p = __libc_memalign(alignment, size);
+    return *p ? 0 : 12; // ENOMEM
+  }
+}
+
+template<typename M>
+size_t steady_state_allocations(M& m) {
+  m.initChain();
+  m.tune(1e3, 10);
+  m.tune_global(1e3, 10);
+
+  allocations = 0;
+  counting = true;
+  for(int i = 0; i < 1e4; i++) {
+    m.step();
+  }
+  counting = false;
+  return allocations;
+}
+
+int main() {
+  const double zero(0), one_e1(0.1), one_e3(0.001);
+
+  const int NR = 1e2;
+  const int NC = 2;
+  const vec real_b = randn<vec>(NC);
+  mat X = mat(NR,NC);
+  X.col(0).fill(1);
+  X.col(1) = randn<mat>(NR,1);
+  const mat y = X * real_b + randn<mat>(NR,1);
+  ivec size(NR), successes(NR);
+  for(int i = 0; i < NR; i++) {
+    const double eta = X(i,0) * real_b[0] + X(i,1) * real_b[1];
+    size[i] = 100;
+    successes[i] = static_cast<int>(size[i] / (1+exp(-eta)));
+  }
+
+  size_t failures = 0;
+  for(int flat = 0; flat < 2; flat++) {
+    vec b(randn<vec>(NC));
+    double tau(1);
+    mat y_hat(NR,1), p_hat(NR,1);
+
+    // written element wise, so the update itself does not allocate either
+    std::function<void ()> model = [&]() {
+      for(int i = 0; i < NR; i++) {
+        double eta = 0;
+        for(int j = 0; j < NC; j++) { eta += X(i,j) * b[j]; }
+        y_hat[i] = eta;
+        p_hat[i] = 1/(1+exp(-eta));
+      }
+    };
+
+    MCModel<boost::minstd_rand> m(model);
+    m.setFlatState(flat);
+    m.track<Normal>(b).dnorm(zero, one_e3);
+    m.track<Gamma>(tau).dgamma(one_e1,one_e1);
+    m.track<ObservedNormal>(y).dnorm(y_hat,tau);
+    m.track<ObservedBinomial>(successes).dbinom(size,p_hat);
+    m.track<Deterministic>(y_hat);
+    m.track<Deterministic>(p_hat);
+
+    const size_t n = steady_state_allocations(m);
+    cout << (flat ? "flat" : "nodes") << " step() allocations: " << n << endl;
+    if(n) { ++failures; }
+  }
+
+  if(failures) {
+    cout << "FAILED: step() allocated" << endl;
+    return 1;
+  }
+  cout << "passed" << endl;
+  return 0;
+};
+#else
+int main() {
+  cout << "skipped: allocation counting needs glibc" << endl;
+  return 0;
+};
+#endif
@@ -16,6 +16,7 @@
 ///////////////////////////////////////////////////////////////////////////
 
 #include <map>
+#include <sstream>
 #include <limits>
 #include <stdexcept>
 #include <RcppArmadillo.h>
@@ -50,7 +51,7 @@ typedef std::map<void*,cppbugs::MCMCObject*> vpMCMCMapT;
 // public interface
 extern "C" SEXP logp(SEXP x_,SEXP rho_);
 extern "C" SEXP createModel(SEXP args_sexp);
-extern "C" SEXP runModel(SEXP mp_, SEXP iterations, SEXP burn_in, SEXP adapt, SEXP thin);
+extern "C" SEXP runModel(SEXP mp_, SEXP iterations, SEXP burn_in, SEXP adapt, SEXP thin, SEXP profile);
 
 // private methods
 cppbugs::MCMCObject* createMCMC(SEXP x, vpArmaMapT& armaMap);
@@ -67,6 +68,7 @@ cppbugs::MCMCObject* createBinomial(SEXP x_, vpArmaMapT& armaMap);
 
 ArmaContext* getArma(SEXP x);
 ArmaContext* mapOrFetch(SEXP x_, vpArmaMapT& armaMap);
+bool singlePrecision(SEXP x_);
 void initArgList(SEXP args, arglistT& arglist, const size_t skip);
 SEXP makeNames(std::vector<const char*>& argnames);
 SEXP createTrace(arglistT& arglist, vpArmaMapT& armaMap, vpMCMCMapT& mcmcMap);
@@ -90,14 +92,20 @@ void initArgList(SEXP args, arglistT& arglist, const size_t skip) {
   }
 }
 
+// linear(..., precision = "single"): X is read as float, accumulated in double
+bool singlePrecision(SEXP x_) {
+  return getAttr(x_, "precision") == "single";
+}
+
 ArmaContext* mapOrFetch(SEXP x_, vpArmaMapT& armaMap) {
   ArmaContext* x_arma(NULL);
   void* vp = rawAddress(x_);
 
   if(armaMap.count(vp)==0) {
     // protect object if adding to armaMap
-    PROTECT(x_);
+    // (after getArma, which may throw, so every protect has its map entry)
     x_arma = getArma(x_);
+    PROTECT(x_);
     armaMap[vp] = x_arma;
   } else {
     x_arma = armaMap[vp];
@@ -237,7 +245,7 @@ SEXP createTrace(arglistT& arglist, vpArmaMapT& armaMap, vpMCMCMapT& mcmcMap) {
   return ans;
 }
 
-SEXP runModel(SEXP m_, SEXP iterations, SEXP burn_in, SEXP adapt, SEXP thin) {
+SEXP runModel(SEXP m_, SEXP iterations, SEXP burn_in, SEXP adapt, SEXP thin, SEXP profile) {
   const int eval_limit = 10;
 
   SEXP env_ = Rf_getAttrib(m_,Rf_install("env"));
@@ -251,6 +259,8 @@ SEXP runModel(SEXP m_, SEXP iterations, SEXP burn_in, SEXP adapt, SEXP thin) {
 
   arglistT arglist;
   std::vector<const char*> argnames;
+  // one per node, "" where the arg is not a symbol, for modelGraph()
+  std::vector<std::string> node_names;
 
   initArgList(m_, arglist, 1);
   for(size_t i = 0; i < arglist.size(); i++) {
@@ -258,6 +268,7 @@ SEXP runModel(SEXP m_, SEXP iterations, SEXP burn_in, SEXP adapt, SEXP thin) {
     // capture arg name
     // FIXME: check class of args to make sure it's mcmc
     if(TYPEOF(arglist[i])==SYMSXP) { argnames.push_back(CHAR(PRINTNAME(arglist[i]))); }
+    node_names.push_back(TYPEOF(arglist[i])==SYMSXP ? CHAR(PRINTNAME(arglist[i])) : "");
 
     // force eval of late bindings
     arglist[i] = forceEval(arglist[i],env_,eval_limit);
@@ -278,25 +289,44 @@ SEXP runModel(SEXP m_, SEXP iterations, SEXP burn_in, SEXP adapt, SEXP thin) {
   int burn_in_ = Rcpp::as<int>(burn_in);
   int adapt_ = Rcpp::as<int>(adapt);
   int thin_ = Rcpp::as<int>(thin);
+  const bool profile_ = Rcpp::as<bool>(profile);
   SEXP ar; PROTECT(ar = Rf_allocVector(REALSXP,1));
+  // the graph is only worth building when it carries the timings
+  SEXP graph; PROTECT(graph = profile_ ? Rf_allocVector(STRSXP,2) : R_NilValue);
   try {
     cppbugs::RMCModel m(mcmcObjects);
+    m.setProfile(profile_);
     m.sample(iterations_, burn_in_, adapt_, thin_);
     //std::cout << "acceptance_ratio: " << m.acceptance_ratio() << std::endl;
     REAL(ar)[0] = m.acceptance_ratio();
+    if(profile_) {
+      const cppbugs::ModelGraph model_graph = m.modelGraph(node_names);
+      std::ostringstream dot, json;
+      model_graph.writeDot(dot);
+      model_graph.writeJson(json);
+      SET_STRING_ELT(graph, 0, Rf_mkChar(dot.str().c_str()));
+      SET_STRING_ELT(graph, 1, Rf_mkChar(json.str().c_str()));
+    }
   } catch (std::logic_error &e) {
-    releaseMap(armaMap); releaseMap(mcmcMap); UNPROTECT(armaMap.size());
-    UNPROTECT(1); // ar
+    releaseMap(armaMap); releaseMap(mcmcMap);
+    UNPROTECT(armaMap.size() + 2); // arma objects + ar + graph
     REprintf("%s\n",e.what());
     return R_NilValue;
   }
 
   SEXP ans;
   PROTECT(ans = createTrace(arglist,armaMap,mcmcMap));
-  releaseMap(armaMap);releaseMap(mcmcMap); UNPROTECT(armaMap.size());
+  releaseMap(armaMap);releaseMap(mcmcMap);
   Rf_setAttrib(ans, R_NamesSymbol, makeNames(argnames));
   Rf_setAttrib(ans, Rf_install("acceptance.ratio"), ar);
-  UNPROTECT(2); // ans + ar
+  if(profile_) {
+    std::vector<const char*> graph_names;
+    graph_names.push_back("dot"); graph_names.push_back("json");
+    Rf_setAttrib(graph, R_NamesSymbol, makeNames(graph_names));
+    Rf_setAttrib(ans, Rf_install("graph"), graph);
+  }
+  // the arma objects stay protected until ans has all its attributes
+  UNPROTECT(armaMap.size() + 3); // arma objects + ans + ar + graph
   return ans;
 }
 
@@ -322,6 +352,12 @@ ArmaContext* getArma(SEXP x_) {
       throw std::logic_error("ERROR: tensor conversion not supported yet.");
     }
     break;
+  case S4SXP:
+    if(Rf_inherits(x_, "dgCMatrix")) {
+      ap = new ArmaSpMat(x_);
+      break;
+    }
+    // other S4 classes fall through to the error
   default:
     std::stringstream error_ss;
     error_ss << "ERROR: (getArma) conversion not supported ";
@@ -474,7 +510,7 @@ cppbugs::MCMCObject* createLinearDeterministic(SEXP x_, vpArmaMapT& armaMap) {
   }
 
   // big X
-  if(X_arma->getArmaType() != matT && X_arma->getArmaType() != imatT) {
+  if(X_arma->getArmaType() != matT && X_arma->getArmaType() != imatT && X_arma->getArmaType() != spmatT) {
     throw std::logic_error("ERROR: createLinearDeterministic, X must be a matrix.");
   }
 
@@ -485,11 +521,18 @@ cppbugs::MCMCObject* createLinearDeterministic(SEXP x_, vpArmaMapT& armaMap) {
 
   switch(X_arma->getArmaType()) {
   case matT:
-    p = new cppbugs::LinearDeterministic<arma::mat>(x_arma->getMat(),X_arma->getMat(),b_arma->getVec());
+    if(singlePrecision(x_)) {
+      p = new cppbugs::LinearDeterministic<arma::fmat>(x_arma->getMat(),X_arma->getfMat(),b_arma->getVec());
+    } else {
+      p = new cppbugs::LinearDeterministic<arma::mat>(x_arma->getMat(),X_arma->getMat(),b_arma->getVec());
+    }
     break;
   case imatT:
     p = new cppbugs::LinearDeterministic<arma::imat>(x_arma->getMat(),X_arma->getiMat(),b_arma->getVec());
     break;
+  case spmatT:
+    p = new cppbugs::LinearDeterministic<arma::sp_mat>(x_arma->getMat(),X_arma->getSpMat(),b_arma->getVec());
+    break;
   default:
     throw std::logic_error("ERROR: createLogisticDeterministic, combination of arguments not supported.");
   }
@@ -542,7 +585,11 @@ cppbugs::MCMCObject* createLinearGroupedDeterministic(SEXP x_, vpArmaMapT& armaM
 
   switch(X_arma->getArmaType()) {
   case matT:
-    p = new cppbugs::LinearGroupedDeterministic<arma::mat>(x_arma->getMat(),X_arma->getMat(),b_arma->getMat(),group_arma->getiVec());
+    if(singlePrecision(x_)) {
+      p = new cppbugs::LinearGroupedDeterministic<arma::fmat>(x_arma->getMat(),X_arma->getfMat(),b_arma->getMat(),group_arma->getiVec());
+    } else {
+      p = new cppbugs::LinearGroupedDeterministic<arma::mat>(x_arma->getMat(),X_arma->getMat(),b_arma->getMat(),group_arma->getiVec());
+    }
     break;
   case imatT:
     p = new cppbugs::LinearGroupedDeterministic<arma::imat>(x_arma->getMat(),X_arma->getiMat(),b_arma->getMat(),group_arma->getiVec());
@@ -580,7 +627,7 @@ cppbugs::MCMCObject* createLogisticDeterministic(SEXP x_, vpArmaMapT& armaMap) {
   }
 
   // big X
-  if(X_arma->getArmaType() != matT && X_arma->getArmaType() != imatT) {
+  if(X_arma->getArmaType() != matT && X_arma->getArmaType() != imatT && X_arma->getArmaType() != spmatT) {
     throw std::logic_error("ERROR: createLogisticDeterministic, X must be a matrix.");
   }
 
@@ -591,11 +638,18 @@ cppbugs::MCMCObject* createLogisticDeterministic(SEXP x_, vpArmaMapT& armaMap) {
 
   switch(X_arma->getArmaType()) {
   case matT:
-    p = new cppbugs::LogisticDeterministic<arma::mat>(x_arma->getMat(),X_arma->getMat(),b_arma->getVec());
+    if(singlePrecision(x_)) {
+      p = new cppbugs::LogisticDeterministic<arma::fmat>(x_arma->getMat(),X_arma->getfMat(),b_arma->getVec());
+    } else {
+      p = new cppbugs::LogisticDeterministic<arma::mat>(x_arma->getMat(),X_arma->getMat(),b_arma->getVec());
+    }
     break;
   case imatT:
     p = new cppbugs::LogisticDeterministic<arma::imat>(x_arma->getMat(),X_arma->getiMat(),b_arma->getVec());
     break;
+  case spmatT:
+    p = new cppbugs::LogisticDeterministic<arma::sp_mat>(x_arma->getMat(),X_arma->getSpMat(),b_arma->getVec());
+    break;
   default:
     throw std::logic_error("ERROR: createLogisticDeterministic, combination of arguments not supported.");
   }
@@ -22,6 +22,7 @@
 //#include <Rcpp.h>
 #include <RcppArmadillo.h>
 #include <cppbugs/mcmc.deterministic.hpp>
+#include "linear.kernels.h"
 
 
 namespace cppbugs {
@@ -31,13 +32,45 @@ namespace cppbugs {
   private:
     const T& X_;
     const arma::vec& b_;
+    PredictorTags<arma::vec> tags_;
   public:
     LinearDeterministic(arma::mat& value, const T& X, const arma::vec& b):
-      Deterministic<arma::mat>(value), X_(X), b_(b) {}
+      Deterministic<arma::mat>(value), X_(X), b_(b) {
+      // jump() rewrites the whole value
+      Deterministic<arma::mat>::setDoubleBuffered(true);
+      linear_predictor_check("createLinearDeterministic", value, X, b);
+    }
 
     void jump(RngBase& rng) {
-      Deterministic<arma::mat>::value = X_ * b_;
+      arma::mat& value = Deterministic<arma::mat>::value;
+      const PredictorUpdate how = tags_.plan(b_);
+      if(how == predictor_full) {
+        linear_predictor(value, X_, b_);
+      } else {
+        if(how == predictor_from_old) {
+          const arma::mat& old_value = Deterministic<arma::mat>::old_value;
+          std::copy(old_value.memptr(), old_value.memptr() + old_value.n_elem, value.memptr());
+        }
+        const std::vector<arma::uword>& changed = tags_.changed(how);
+        const arma::vec& from = tags_.from(how);
+        for(size_t k = 0; k < changed.size(); k++) {
+          add_column_of(value.memptr(), b_[changed[k]] - from[changed[k]], X_, changed[k]);
+        }
+      }
+      tags_.commit(how, b_);
+    }
+
+    // the tags follow the values, whether the buffers were swapped or copied
+    void preserve() {
+      Deterministic<arma::mat>::preserve();
+      if(Deterministic<arma::mat>::swapping()) { tags_.swap(); } else { tags_.copyToOld(); }
     }
+    void revert() {
+      Deterministic<arma::mat>::revert();
+      if(Deterministic<arma::mat>::swapping()) { tags_.swap(); } else { tags_.copyFromOld(); }
+    }
+
+    void inputs(std::vector<const void*>& out) const { out.push_back(&X_); out.push_back(&b_); }
   };
 } // namespace cppbugs
 #endif //LINEAR_DETERMINISTIC_H
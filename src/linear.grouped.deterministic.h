@@ -19,8 +19,10 @@
 #ifndef LINEAR_GROUPED_DETERMINISTIC_H
 #define LINEAR_GROUPED_DETERMINISTIC_H
 
+#include <vector>
 #include <RcppArmadillo.h>
 #include <cppbugs/mcmc.deterministic.hpp>
+#include "linear.kernels.h"
 
 
 namespace cppbugs {
@@ -32,10 +34,17 @@ namespace cppbugs {
     const arma::mat& b_;
     const arma::ivec& group_;
     arma::uvec group_0_index_;
+    // runs of rows sharing a group, empty when X is not ordered by group
+    std::vector<GroupRun> runs_;
+    PredictorTags<arma::mat> tags_;
+    // change of one column of b, for the incremental updates
+    arma::vec delta_;
   public:
-    LinearGroupedDeterministic(arma::mat& value, const T& X, const arma::mat& b, const arma::ivec group):
-      Deterministic<arma::mat>(value), X_(X), b_(b), group_(group), group_0_index_(arma::conv_to<arma::uvec>::from(group - 1))
+    LinearGroupedDeterministic(arma::mat& value, const T& X, const arma::mat& b, const arma::ivec& group):
+      Deterministic<arma::mat>(value), X_(X), b_(b), group_(group), group_0_index_(arma::conv_to<arma::uvec>::from(group - 1)), runs_(group_runs(group_0_index_)), delta_(b.n_rows)
     {
+      // jump() rewrites the whole value
+      Deterministic<arma::mat>::setDoubleBuffered(true);
       int max_index = max(group);
       int min_index = min(group);
       if(max_index > b.n_rows || min_index < 1) {
@@ -44,13 +53,49 @@ namespace cppbugs {
       if(group.n_elem != X.n_rows) {
         throw std::logic_error("ERROR: createLinearGroupedDeterministic, group index does not match number of rows of X.");
       }
+      if(b.n_cols != X.n_cols) {
+        throw std::logic_error("ERROR: createLinearGroupedDeterministic, columns of b do not match columns of X.");
+      }
+      if(value.n_elem != X.n_rows) {
+        throw std::logic_error("ERROR: createLinearGroupedDeterministic, x does not match number of rows of X.");
+      }
     }
 
     void jump(RngBase& rng) {
-      //group_0_index = group - 1;
-      Deterministic<arma::mat>::value = arma::sum(X_ % b_.rows(group_0_index_),1);
-      //Deterministic<arma::mat>::value = arma::sum(X_ %*% b_.rows(group_-1),1);
+      // value = arma::sum(X_ % b_.rows(group_0_index_),1) without the temporaries
+      arma::mat& value = Deterministic<arma::mat>::value;
+      const PredictorUpdate how = tags_.plan(b_);
+      if(how == predictor_full) {
+        grouped_linear_predictor(value, X_, b_, group_0_index_, runs_);
+      } else {
+        if(how == predictor_from_old) {
+          const arma::mat& old_value = Deterministic<arma::mat>::old_value;
+          std::copy(old_value.memptr(), old_value.memptr() + old_value.n_elem, value.memptr());
+        }
+        const std::vector<arma::uword>& changed = tags_.changed(how);
+        const arma::mat& from = tags_.from(how);
+        for(size_t k = 0; k < changed.size(); k++) {
+          const arma::uword j = changed[k];
+          for(arma::uword g = 0; g < b_.n_rows; g++) {
+            delta_[g] = b_(g, j) - from(g, j);
+          }
+          add_grouped_column(value.memptr(), X_.colptr(j), delta_.memptr(), group_0_index_, runs_);
+        }
+      }
+      tags_.commit(how, b_);
     }
+
+    // the tags follow the values, whether the buffers were swapped or copied
+    void preserve() {
+      Deterministic<arma::mat>::preserve();
+      if(Deterministic<arma::mat>::swapping()) { tags_.swap(); } else { tags_.copyToOld(); }
+    }
+    void revert() {
+      Deterministic<arma::mat>::revert();
+      if(Deterministic<arma::mat>::swapping()) { tags_.swap(); } else { tags_.copyFromOld(); }
+    }
+
+    void inputs(std::vector<const void*>& out) const { out.push_back(&X_); out.push_back(&b_); out.push_back(&group_); }
   };
 } // namespace cppbugs
 #endif //LINEAR_GROUPED_DETERMINISTIC_H
@@ -0,0 +1,260 @@
+// -*- mode: C++; c-indent-level: 2; c-basic-offset: 2; tab-width: 8 -*-
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2012 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef LINEAR_KERNELS_H
+#define LINEAR_KERNELS_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <RcppArmadillo.h>
+#include <cppbugs/mcmc.dispatch.hpp>
+
+namespace cppbugs {
+
+  // in place kernels for the linear predictor nodes
+  // out is R owned memory of the right size, so nothing is allocated per call
+
+  // y += x * a for one column of X
+  template<typename eT>
+  void add_column(double* y, const double a, const eT* x, const arma::uword n) {
+    for(arma::uword i = 0; i < n; i++) {
+      y[i] += x[i] * a;
+    }
+  }
+
+  inline void add_column(double* y, const double a, const double* x, const arma::uword n) {
+    kernels().axpy(y, a, x, n);
+  }
+
+  // y += X.col(j) * a, X dense (real or integer valued) or compressed sparse column
+  template<typename eT>
+  void add_column_of(double* y, const double a, const arma::Mat<eT>& X, const arma::uword j) {
+    add_column(y, a, X.colptr(j), X.n_rows);
+  }
+
+  inline void add_column_of(double* y, const double a, const arma::sp_mat& X, const arma::uword j) {
+    for(arma::uword k = X.col_ptrs[j]; k < X.col_ptrs[j + 1]; k++) {
+      y[X.row_indices[k]] += X.values[k] * a;
+    }
+  }
+
+  // out = X * b, one pass down each column of X (X may be real, single precision
+  // or integer valued; the products are always accumulated in double)
+  template<typename eT>
+  void linear_predictor(arma::mat& out, const arma::Mat<eT>& X, const arma::vec& b) {
+    const arma::uword n = X.n_rows;
+    double* y = out.memptr();
+    std::fill(y, y + n, 0.0);
+    for(arma::uword j = 0; j < X.n_cols; j++) {
+      add_column(y, b[j], X.colptr(j), n);
+    }
+  }
+
+  // out = X * b for a compressed sparse column X (Matrix::dgCMatrix), only the
+  // stored entries are visited, so the cost is the number of non zeros
+  inline void linear_predictor(arma::mat& out, const arma::sp_mat& X, const arma::vec& b) {
+    double* y = out.memptr();
+    std::fill(y, y + X.n_rows, 0.0);
+    const arma::uword* col_ptrs = X.col_ptrs;
+    const arma::uword* row_indices = X.row_indices;
+    const double* values = X.values;
+    for(arma::uword j = 0; j < X.n_cols; j++) {
+      const double bj = b[j];
+      for(arma::uword k = col_ptrs[j]; k < col_ptrs[j + 1]; k++) {
+        y[row_indices[k]] += values[k] * bj;
+      }
+    }
+  }
+
+  inline void logistic_in_place(arma::mat& x) {
+    double* y = x.memptr();
+    for(arma::uword i = 0; i < x.n_elem; i++) {
+      y[i] = 1/(1+exp(-y[i]));
+    }
+  }
+
+  // rows [begin, end) of X that all use row b_row of the grouped coefficients
+  struct GroupRun {
+    arma::uword begin, end, b_row;
+  };
+
+  // runs of consecutive rows sharing a group, left empty unless the rows are
+  // mostly ordered by group (mean run length of at least min_length), when
+  // the per row lookup of b is not worth replacing
+  inline std::vector<GroupRun> group_runs(const arma::uvec& group_0_index, const arma::uword min_length = 4) {
+    std::vector<GroupRun> runs;
+    const arma::uword n = group_0_index.n_elem;
+    for(arma::uword i = 0; i < n; ) {
+      GroupRun r;
+      r.begin = i;
+      r.b_row = group_0_index[i];
+      while(i < n && group_0_index[i] == r.b_row) { ++i; }
+      r.end = i;
+      runs.push_back(r);
+    }
+    if(runs.size() * min_length > n) {
+      runs.clear();
+    }
+    return runs;
+  }
+
+  // y[i] += x_col[i] * b_col[group[i]] for one column of X and of the grouped coefficients
+  template<typename eT>
+  void add_grouped_column(double* y, const eT* x_col, const double* b_col, const arma::uvec& group_0_index, const std::vector<GroupRun>& runs) {
+    if(runs.empty()) {
+      const arma::uword* g = group_0_index.memptr();
+      for(arma::uword i = 0; i < group_0_index.n_elem; i++) {
+        y[i] += x_col[i] * b_col[g[i]];
+      }
+    } else {
+      for(std::vector<GroupRun>::const_iterator r = runs.begin(); r != runs.end(); ++r) {
+        add_column(y + r->begin, b_col[r->b_row], x_col + r->begin, r->end - r->begin);
+      }
+    }
+  }
+
+  // out[i] = dot(X.row(i), b.row(group[i])), one pass down each column of X
+  // reading b straight from its column, so no gathered copy of b is built
+  template<typename eT>
+  void grouped_linear_predictor(arma::mat& out, const arma::Mat<eT>& X, const arma::mat& b, const arma::uvec& group_0_index, const std::vector<GroupRun>& runs) {
+    double* y = out.memptr();
+    std::fill(y, y + X.n_rows, 0.0);
+    for(arma::uword j = 0; j < X.n_cols; j++) {
+      add_grouped_column(y, X.colptr(j), b.colptr(j), group_0_index, runs);
+    }
+  }
+
+  // incremental updates of a linear predictor
+  // a node's value buffers each remember the coefficients they were computed
+  // from, so a jump which moved only a few coefficients (elements of a vector
+  // b, columns of a grouped b) adds X.col(j) * delta_j instead of recomputing
+  // X * b; a full recompute is done when most coefficients moved and after
+  // predictor_refresh updates in a row, which bounds the rounding drift
+  const unsigned int predictor_refresh = 1000;
+
+  template<typename B>
+  struct PredictorTag {
+    B b;
+    bool valid;
+    unsigned int updates;
+    PredictorTag(): valid(false), updates(0) {}
+  };
+
+  // coefficient units: elements of a vector, columns of a matrix
+  inline arma::uword coefficient_units(const arma::vec& b) { return b.n_elem; }
+  inline arma::uword coefficient_units(const arma::mat& b) { return b.n_cols; }
+
+  inline void changed_units(std::vector<arma::uword>& changed, const arma::vec& b, const arma::vec& from) {
+    changed.clear();
+    for(arma::uword j = 0; j < b.n_elem; j++) {
+      if(b[j] != from[j]) { changed.push_back(j); }
+    }
+  }
+
+  inline void changed_units(std::vector<arma::uword>& changed, const arma::mat& b, const arma::mat& from) {
+    changed.clear();
+    for(arma::uword j = 0; j < b.n_cols; j++) {
+      if(!std::equal(b.colptr(j), b.colptr(j) + b.n_rows, from.colptr(j))) { changed.push_back(j); }
+    }
+  }
+
+  inline void copy_unit(arma::vec& to, const arma::vec& from, const arma::uword j) { to[j] = from[j]; }
+  inline void copy_unit(arma::mat& to, const arma::mat& from, const arma::uword j) {
+    std::copy(from.colptr(j), from.colptr(j) + from.n_rows, to.colptr(j));
+  }
+
+  enum PredictorUpdate { predictor_full, predictor_in_place, predictor_from_old };
+
+  // the tags of a node's value and old_value buffers, swapped with them
+  template<typename B>
+  class PredictorTags {
+  private:
+    PredictorTag<B> tags_[2];
+    int active_;
+    std::vector<arma::uword> in_place_, from_old_;
+
+    bool usable(const PredictorTag<B>& tag) const { return tag.valid && tag.updates < predictor_refresh; }
+  public:
+    PredictorTags(): active_(0) {}
+    // the value buffers were swapped (preserve or revert of a double buffered value)
+    void swap() { active_ = 1 - active_; }
+    // the value was copied into old_value (preserve) or back (revert)
+    void copyToOld() { tags_[1 - active_] = tags_[active_]; }
+    void copyFromOld() { tags_[active_] = tags_[1 - active_]; }
+    void invalidate() { tags_[0].valid = tags_[1].valid = false; }
+
+    // cheapest way to bring the value buffer to b, with the units to add in changed()
+    PredictorUpdate plan(const B& b) {
+      const arma::uword units = coefficient_units(b);
+      arma::uword in_place_cost = units + 1, from_old_cost = units + 1;
+      if(usable(tags_[active_])) {
+        changed_units(in_place_, b, tags_[active_].b);
+        in_place_cost = in_place_.size();
+      }
+      if(usable(tags_[1 - active_])) {
+        changed_units(from_old_, b, tags_[1 - active_].b);
+        // plus the copy of old_value
+        from_old_cost = from_old_.size() + 1;
+      }
+      const arma::uword best = std::min(in_place_cost, from_old_cost);
+      if(2 * best > units) {
+        return predictor_full;
+      }
+      return in_place_cost <= from_old_cost ? predictor_in_place : predictor_from_old;
+    }
+
+    const std::vector<arma::uword>& changed(const PredictorUpdate how) const { return how == predictor_from_old ? from_old_ : in_place_; }
+    // the coefficients the update starts from
+    const B& from(const PredictorUpdate how) const { return tags_[how == predictor_from_old ? 1 - active_ : active_].b; }
+
+    // record that the value buffer now holds the predictor of b
+    void commit(const PredictorUpdate how, const B& b) {
+      PredictorTag<B>& tag = tags_[active_];
+      if(how == predictor_full) {
+        tag.b = b;
+        tag.updates = 0;
+      } else {
+        if(how == predictor_from_old) {
+          tag.b = tags_[1 - active_].b;
+          tag.updates = tags_[1 - active_].updates;
+        }
+        // an update which changed nothing adds no rounding to the buffer
+        const std::vector<arma::uword>& units = changed(how);
+        for(size_t k = 0; k < units.size(); k++) {
+          copy_unit(tag.b, b, units[k]);
+        }
+        if(!units.empty()) { tag.updates++; }
+      }
+      tag.valid = true;
+    }
+  };
+
+  // X is any dense or sparse arma matrix
+  template<typename M>
+  void linear_predictor_check(const char* caller, const arma::mat& out, const M& X, const arma::vec& b) {
+    if(b.n_elem != X.n_cols) {
+      throw std::logic_error(std::string("ERROR: ") + caller + ", length of b does not match number of columns of X.");
+    }
+    if(out.n_elem != X.n_rows) {
+      throw std::logic_error(std::string("ERROR: ") + caller + ", x does not match number of rows of X.");
+    }
+  }
+} // namespace cppbugs
+#endif //LINEAR_KERNELS_H
@@ -22,6 +22,7 @@
 //#include <Rcpp.h>
 #include <RcppArmadillo.h>
 #include <cppbugs/mcmc.deterministic.hpp>
+#include "linear.kernels.h"
 
 
 namespace cppbugs {
@@ -33,11 +34,18 @@ namespace cppbugs {
     const arma::vec& b_;
   public:
     LogisticDeterministic(arma::mat& value, const T& X, const arma::vec& b):
-      Deterministic<arma::mat>(value), X_(X), b_(b) {}
+      Deterministic<arma::mat>(value), X_(X), b_(b) {
+      // jump() rewrites the whole value
+      Deterministic<arma::mat>::setDoubleBuffered(true);
+      linear_predictor_check("createLogisticDeterministic", value, X, b);
+    }
 
-    void jump(RngBase& rng) {      
-      Deterministic<arma::mat>::value = 1/(1+exp(-X_*b_));
+    void jump(RngBase& rng) {
+      linear_predictor(Deterministic<arma::mat>::value, X_, b_);
+      logistic_in_place(Deterministic<arma::mat>::value);
     }
+
+    void inputs(std::vector<const void*>& out) const { out.push_back(&X_); out.push_back(&b_); }
   };
 } // namespace cppbugs
 #endif //LOGISTIC_DETERMINISTIC_H
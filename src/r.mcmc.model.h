@@ -22,9 +22,13 @@
 #include <cmath>
 #include <vector>
 #include <map>
+#include <string>
 #include <exception>
 #include <cppbugs/mcmc.object.hpp>
 #include <cppbugs/mcmc.stochastic.hpp>
+#include <cppbugs/mcmc.math.hpp>
+#include <cppbugs/mcmc.likelihood.reducer.hpp>
+#include <cppbugs/mcmc.model.graph.hpp>
 #include "mcmc.rng.h"
 
 namespace cppbugs {
@@ -35,9 +39,27 @@ namespace cppbugs {
     RNativeRng rng_;
     std::vector<MCMCObject*> mcmcObjects_, dynamic_nodes, determinsitic_nodes;
     std::vector<Likelihiood*> logp_functors;
-   
-    void jump() { for(size_t i = 0; i < dynamic_nodes.size(); i++) { dynamic_nodes[i]->jump(rng_); } }
-    void jump_detrministics() { for(size_t i = 0; i < determinsitic_nodes.size(); i++) { determinsitic_nodes[i]->jump(rng_); } }
+    // cheapest first, blocked and serial, so large likelihoods sum as in MCModel
+    LikelihoodReducer reducer_;
+    // setProfile(): timings for modelGraph(), indexed like mcmcObjects_; the
+    // likelihood times are kept by reducer_ and added in by modelGraph()
+    bool profile_;
+    std::vector<NodeProfile> profiles_;
+    size_t profile_iterations_;
+    std::map<const MCMCObject*, size_t> node_index_;
+    std::map<const Likelihiood*, size_t> functor_owner_;
+
+    void node_jump(MCMCObject* node) {
+      if(!profile_) { node->jump(rng_); return; }
+      const double t0 = profile_clock();
+      node->jump(rng_);
+      NodeProfile& p = profiles_[node_index_[node]];
+      p.jump_time += profile_clock() - t0;
+      p.jumps++;
+    }
+
+    void jump() { for(size_t i = 0; i < dynamic_nodes.size(); i++) { node_jump(dynamic_nodes[i]); } }
+    void jump_detrministics() { for(size_t i = 0; i < determinsitic_nodes.size(); i++) { node_jump(determinsitic_nodes[i]); } }
     void preserve() { for(size_t i = 0; i < dynamic_nodes.size(); i++) { dynamic_nodes[i]->preserve(); } }
     void revert() { for(size_t i = 0; i < dynamic_nodes.size(); i++) { dynamic_nodes[i]->revert(); } }
     void set_scale(const double scale) { for(size_t i = 0; i < dynamic_nodes.size(); i++) { dynamic_nodes[i]->setScale(scale); } }
@@ -55,6 +77,12 @@ namespace cppbugs {
     }
 
     void initChain() {
+      profiles_.assign(mcmcObjects_.size(), NodeProfile());
+      for(size_t i = 0; i < mcmcObjects_.size(); i++) {
+        node_index_[mcmcObjects_[i]] = i;
+        Stochastic* sp = dynamic_cast<Stochastic*>(mcmcObjects_[i]);
+        if(sp && sp->getLikelihoodFunctor()) { functor_owner_[sp->getLikelihoodFunctor()] = i; }
+      }
       for(std::vector<MCMCObject*>::iterator node = mcmcObjects_.begin(); node != mcmcObjects_.end(); node++) {
         // FIXME: add test here to check starting from invalid logp or NaN
         addStochcasticNode(*node);
@@ -67,6 +95,7 @@ namespace cppbugs {
           dynamic_nodes.push_back(*node);
         }
       }
+      reducer_.plan(logp_functors);
       // init logp
       logp_value_ = logp();
     }
@@ -85,7 +114,7 @@ namespace cppbugs {
 	for(std::vector<MCMCObject*>::iterator it = dynamic_nodes.begin(); it != dynamic_nodes.end(); it++) {
           old_logp_value_ = logp_value_;
           (*it)->preserve();
-          (*it)->jump(rng_);
+          node_jump(*it);
 
           // has to be done after each stoch jump
           jump_detrministics();
@@ -98,6 +127,7 @@ namespace cppbugs {
             (*it)->accept();
           }
 	}
+	profile_iterations_++;
 	if(i % tuning_step == 0) {
 	  for(std::vector<MCMCObject*>::iterator itdyn = dynamic_nodes.begin(); itdyn != dynamic_nodes.end(); itdyn++) {
 	    (*itdyn)->tune();
@@ -107,6 +137,7 @@ namespace cppbugs {
     }
 
     void step() {
+      profile_iterations_++;
       old_logp_value_ = logp_value_;
       preserve();
       jump();
@@ -160,7 +191,8 @@ namespace cppbugs {
 
   public:
     // FIXME: use generic iterators later...
-    RMCModel(std::vector<MCMCObject*> mcmcObjects): accepted_(0), rejected_(0), logp_value_(-std::numeric_limits<double>::infinity()), old_logp_value_(-std::numeric_limits<double>::infinity()), mcmcObjects_(mcmcObjects) {
+    RMCModel(std::vector<MCMCObject*> mcmcObjects): accepted_(0), rejected_(0), logp_value_(-std::numeric_limits<double>::infinity()), old_logp_value_(-std::numeric_limits<double>::infinity()), mcmcObjects_(mcmcObjects), profile_(false), profile_iterations_(0) {
+      warm_math_tables();
       initChain();
       if(logp()==-std::numeric_limits<double>::infinity()) {
         throw std::logic_error("ERROR: cannot start from a logp of -Inf.");
@@ -172,12 +204,26 @@ namespace cppbugs {
     }
 
     double logp() const {
-      double ans(0);
-      //for(auto f : logp_functors) {
-      for(std::vector<Likelihiood*>::const_iterator it = logp_functors.begin(); it != logp_functors.end(); it++) {
-        ans += (*it)->calc();
+      return reducer_.sum(logp_functors);
+    }
+
+    // time every jump and likelihood evaluation of sample() for modelGraph()
+    void setProfile(const bool profile) {
+      profile_ = profile;
+      profiles_.assign(mcmcObjects_.size(), NodeProfile());
+      profile_iterations_ = 0;
+      reducer_.setTiming(profile);
+    }
+
+    // names are those of the model's arguments, in the same order as its nodes
+    ModelGraph modelGraph(const std::vector<std::string>& names) const {
+      std::vector<NodeProfile> profiles(profiles_);
+      for(size_t i = 0; i < logp_functors.size(); i++) {
+        NodeProfile& p = profiles[functor_owner_.find(logp_functors[i])->second];
+        p.calc_time += reducer_.time(i);
+        p.calcs += reducer_.count(i);
       }
-      return ans;
+      return build_model_graph(mcmcObjects_, names, profiles, profile_iterations_);
     }
 
     void sample(int iterations, int burn, int adapt, int thin) {
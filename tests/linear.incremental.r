@@ -0,0 +1,25 @@
+## linear() updates its value incrementally from the coefficients which
+## changed; after every jump and every reject it must still be X %*% b
+NR <- 1000
+NC <- 5
+b <- mcmc.normal(rnorm(NC),mu=0,tau=0.001)
+X <- matrix(rnorm(NR * NC),NR,NC)
+tau.y <- mcmc.uniform(runif(1),0,100)
+
+y.hat <- linear(X,b)
+
+## runs after y.hat is recomputed, so it sees every value the chain proposes
+worst <- 0
+y.check <- deterministic(function(y.hat,b) {
+    worst <<- max(worst, abs(y.hat - X %*% b))
+    0
+}, y.hat, b)
+
+y <- mcmc.normal(X %*% rnorm(NC) + rnorm(NR),observed=TRUE,mu=y.hat,tau=tau.y)
+
+ans <- run.model(list(b,tau.y,y.hat,y.check,y), iterations=1e4, burn=1e3, adapt=1e3, thin=10)
+
+## the final state, after whatever the last step accepted or rejected
+stopifnot(isTRUE(all.equal(as.vector(y.hat), as.vector(X %*% b), tolerance=1e-10)))
+stopifnot(worst < 1e-8 * max(abs(y.hat)))
+get.ar(ans)
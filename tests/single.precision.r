@@ -0,0 +1,31 @@
+## precision="single" reads X as floats but accumulates in double: its linear
+## predictor must match X %*% b to float precision, and from the same seed it
+## must fit the same model as "double" (an accept decision flipped by rounding
+## only leaves Monte Carlo error between them)
+NR <- 1000
+NC <- 3
+X <- matrix(rnorm(NR * NC),NR,NC)
+y.data <- X %*% c(1,-2,0.5) + rnorm(NR)
+
+fit <- function(precision) {
+    set.seed(20121003)
+    b <- mcmc.normal(rnorm(NC),mu=0,tau=0.001)
+    tau.y <- mcmc.uniform(runif(1),0,100)
+    y.hat <- linear(X,b,precision=precision)
+    y <- mcmc.normal(y.data,observed=TRUE,mu=y.hat,tau=tau.y)
+    ans <- run.model(list(b,tau.y,y.hat,y), iterations=1e4, burn=1e3, adapt=1e3, thin=10)
+    ## y.hat and b hold the chain's final state
+    stopifnot(max(abs(y.hat - X %*% b)) < 1e-6 * max(abs(y.hat)))
+    c(colMeans(ans[[1]]), mean(ans[[2]]))
+}
+
+double <- fit("double")
+single <- fit("single")
+print(rbind(double, single))
+stopifnot(isTRUE(all.equal(double, single, tolerance=0.05)))
+
+## single precision is only offered for a dense double X
+b <- mcmc.normal(rnorm(NC),mu=0,tau=0.001)
+X.int <- matrix(rbinom(NR * NC, 5, 0.5),NR,NC)
+stopifnot(inherits(try(linear(X.int,b,precision="single"),silent=TRUE),"try-error"))
+stopifnot(inherits(try(logistic(X.int,b,precision="single"),silent=TRUE),"try-error"))
@@ -0,0 +1,26 @@
+## linear() with a sparse X (Matrix::dgCMatrix) must fit the same model as
+## with the same X stored dense
+if(requireNamespace("Matrix", quietly=TRUE)) {
+    NR <- 1000
+    NC <- 4
+    X.dense <- matrix(rnorm(NR * NC) * rbinom(NR * NC, 1, 0.2),NR,NC)
+    X.dense[,1] <- 1
+    nz <- which(X.dense != 0, arr.ind=TRUE)
+    X.sparse <- Matrix::sparseMatrix(i=nz[,1], j=nz[,2], x=X.dense[nz], dims=c(NR,NC))
+    y.data <- X.dense %*% c(1,-2,0.5,3) + rnorm(NR)
+
+    fit <- function(X) {
+        b <- mcmc.normal(rnorm(NC),mu=0,tau=0.001)
+        tau.y <- mcmc.uniform(runif(1),0,100)
+        y.hat <- linear(X,b)
+        y <- mcmc.normal(y.data,observed=TRUE,mu=y.hat,tau=tau.y)
+        ans <- run.model(list(b,tau.y,y.hat,y), iterations=1e4, burn=1e3, adapt=1e3, thin=10)
+        c(colMeans(ans[[1]]), mean(ans[[2]]))
+    }
+
+    dense <- fit(X.dense)
+    sparse <- fit(X.sparse)
+    print(rbind(dense, sparse))
+    ## separate chains, so the estimates agree to within Monte Carlo error
+    stopifnot(isTRUE(all.equal(dense, sparse, tolerance=0.05)))
+}